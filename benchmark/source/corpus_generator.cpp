@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <vector>
+
+#include "corpus_generator.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// splitmix64; unlike the <random> distributions, its output is the same
+// with every standard library
+class random_generator
+{
+public:
+  explicit random_generator(std::uint64_t seed)
+      : m_state(seed)
+  {
+  }
+
+  std::uint64_t next()
+  {
+    auto z = (m_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // In [0, bound)
+  std::size_t below(std::size_t bound)
+  {
+    return bound == 0 ? 0 : static_cast<std::size_t>(next() % bound);
+  }
+
+  // Around `mean`, give or take half of it
+  std::size_t around(std::size_t mean)
+  {
+    return mean == 0 ? 0 : mean / 2 + below(mean + 1);
+  }
+
+private:
+  std::uint64_t m_state;
+};
+
+void write_statements(std::ofstream& out,
+                      random_generator& random,
+                      std::size_t count)
+{
+  out << "    int result = value;\n";
+  for (std::size_t i = 0; i < count; ++i) {
+    switch (random.below(5)) {
+      case 0:
+        out << "    result += " << random.below(1000) << ";\n";
+        break;
+      case 1:
+        out << "    result = static_cast<int>(result * 1.5);\n";
+        break;
+      case 2:
+        out << "    for (int i = 0; i < " << 1 + random.below(16)
+            << "; ++i) {\n      result ^= i;\n    }\n";
+        break;
+      case 3:
+        out << "    if (result > " << random.below(100000)
+            << ") {\n      result -= value;\n    }\n";
+        break;
+      default:
+        out << "    const auto local_" << i << " = result % "
+            << 1 + random.below(97) << ";\n    result += local_" << i
+            << ";\n";
+        break;
+    }
+  }
+  out << "    return result;\n";
+}
+
+void write_class(std::ofstream& out,
+                 random_generator& random,
+                 const std::string& name,
+                 const search::corpus_options& options)
+{
+  out << "class " << name << "\n{\npublic:\n";
+  out << "  explicit " << name << "(int value)\n      : m_value(value)\n"
+      << "  {\n  }\n\n";
+  const auto functions = random.around(options.functions_per_class);
+  for (std::size_t i = 0; i < functions; ++i) {
+    out << "  int method_" << i << "(int value) const\n  {\n";
+    write_statements(
+        out, random, random.around(options.statements_per_function));
+    out << "  }\n\n";
+  }
+  out << "private:\n  int m_value;\n};\n\n";
+}
+
+void write_header(const fs::path& path,
+                  random_generator& random,
+                  const std::string& prefix,
+                  std::size_t level,
+                  const search::corpus_options& options)
+{
+  std::ofstream out(path);
+  out << "#pragma once\n";
+  if (level + 1 < options.include_depth) {
+    out << "#include \"" << prefix << "_" << level + 1 << ".hpp\"\n";
+  }
+  out << "\nnamespace corpus\n{\n";
+  write_class(out, random, prefix + "_type_" + std::to_string(level), options);
+  out << "}  // namespace corpus\n";
+}
+
+void write_source(const fs::path& path,
+                  random_generator& random,
+                  const std::string& prefix,
+                  bool hit,
+                  const search::corpus_options& options)
+{
+  std::ofstream out(path);
+  if (options.include_depth > 0) {
+    out << "#include \"" << prefix << "_0.hpp\"\n";
+  }
+  out << "\nnamespace corpus\n{\n";
+
+  const auto classes = random.around(options.classes_per_file);
+  // A hit file has one more class and one more function, both matching
+  const auto hit_class = random.below(classes + 1);
+  for (std::size_t i = 0; i <= classes; ++i) {
+    if (hit && i == hit_class) {
+      write_class(out, random, options.query + "_" + prefix, options);
+    }
+    if (i < classes) {
+      write_class(
+          out, random, prefix + "_class_" + std::to_string(i), options);
+    }
+  }
+
+  const auto functions = random.around(options.functions_per_file);
+  for (std::size_t i = 0; i < functions + (hit ? 1 : 0); ++i) {
+    const auto name = i == functions
+        ? options.query + "_function_" + prefix
+        : prefix + "_function_" + std::to_string(i);
+    out << "int " << name << "(int value)\n{\n";
+    write_statements(
+        out, random, random.around(options.statements_per_function));
+    out << "}\n\n";
+  }
+  out << "}  // namespace corpus\n";
+}
+
+}  // namespace
+
+namespace search
+{
+std::size_t generate_corpus(const fs::path& root,
+                            const corpus_options& options)
+{
+  random_generator random(options.seed);
+
+  // Exactly round(hit_rate * files) hits, spread over the corpus
+  std::vector<std::size_t> order(options.files);
+  std::iota(order.begin(), order.end(), 0);
+  for (std::size_t i = order.size(); i > 1; --i) {
+    std::swap(order[i - 1], order[random.below(i)]);
+  }
+  const auto hits = static_cast<std::size_t>(std::lround(
+      std::clamp(options.hit_rate, 0.0, 1.0) * options.files));
+  std::vector<bool> is_hit(options.files, false);
+  for (std::size_t i = 0; i < hits; ++i) {
+    is_hit[order[i]] = true;
+  }
+
+  std::size_t written = 0;
+  const auto directories = std::max<std::size_t>(options.directories, 1);
+  for (std::size_t file = 0; file < options.files; ++file) {
+    const auto directory =
+        root / ("module_" + std::to_string(file % directories));
+    fs::create_directories(directory);
+
+    const auto prefix = "unit_" + std::to_string(file);
+    for (std::size_t level = 0; level < options.include_depth; ++level) {
+      write_header(directory / (prefix + "_" + std::to_string(level) + ".hpp"),
+                   random,
+                   prefix,
+                   level,
+                   options);
+      ++written;
+    }
+    write_source(
+        directory / (prefix + ".cpp"), random, prefix, is_hit[file], options);
+    ++written;
+  }
+  return written;
+}
+
+}  // namespace search
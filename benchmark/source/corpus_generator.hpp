@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace search
+{
+// The shape of a synthetic C++ code base. The same options always
+// generate the same files.
+struct corpus_options
+{
+  // Source files, each with its own chain of headers
+  std::size_t files {100};
+  // The source files are spread over this many directories
+  std::size_t directories {10};
+  // Each source file includes a header, which includes the next one, and
+  // so on, this many levels deep
+  std::size_t include_depth {2};
+  // Per source file; every header has one class
+  std::size_t classes_per_file {4};
+  std::size_t functions_per_class {6};
+  // Free functions per source file
+  std::size_t functions_per_file {4};
+  // The size of every function body, in statements
+  std::size_t statements_per_function {8};
+  // The fraction of source files with declarations matching `query`; no
+  // other file contains it anywhere, as long as it is not part of one of
+  // the generated names (e.g., "value")
+  double hit_rate {0.1};
+  std::string query {"needle"};
+  std::uint64_t seed {1};
+};
+
+// Writes the corpus under `root`, which is created if needed. Returns the
+// number of files written.
+std::size_t generate_corpus(const std::filesystem::path& root,
+                            const corpus_options& options);
+
+}  // namespace search
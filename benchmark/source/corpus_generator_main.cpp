@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "corpus_generator.hpp"
+
+// Writes a synthetic corpus for trying fccf on, e.g.,
+//
+//   fccf_corpus_generator --files 1000 --hit-rate 0.05 /tmp/corpus
+//   fccf --stats needle /tmp/corpus
+int main(int argc, char* argv[])
+{
+  search::corpus_options options;
+  const char* root = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (arg[0] != '-') {
+      root = arg;
+      continue;
+    }
+    if (i + 1 == argc) {
+      std::fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    }
+    const char* value = argv[++i];
+    const auto number = [value] { return std::strtoull(value, nullptr, 10); };
+
+    if (std::strcmp(arg, "--files") == 0) {
+      options.files = number();
+    } else if (std::strcmp(arg, "--directories") == 0) {
+      options.directories = number();
+    } else if (std::strcmp(arg, "--include-depth") == 0) {
+      options.include_depth = number();
+    } else if (std::strcmp(arg, "--classes") == 0) {
+      options.classes_per_file = number();
+    } else if (std::strcmp(arg, "--methods") == 0) {
+      options.functions_per_class = number();
+    } else if (std::strcmp(arg, "--functions") == 0) {
+      options.functions_per_file = number();
+    } else if (std::strcmp(arg, "--statements") == 0) {
+      options.statements_per_function = number();
+    } else if (std::strcmp(arg, "--hit-rate") == 0) {
+      options.hit_rate = std::strtod(value, nullptr);
+    } else if (std::strcmp(arg, "--query") == 0) {
+      options.query = value;
+    } else if (std::strcmp(arg, "--seed") == 0) {
+      options.seed = number();
+    } else {
+      std::fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+
+  if (root == nullptr) {
+    std::fprintf(stderr,
+                 "Usage: %s [--files N] [--directories N] "
+                 "[--include-depth N] [--classes N] [--methods N] "
+                 "[--functions N] [--statements N] [--hit-rate X] "
+                 "[--query NAME] [--seed N] OUTPUT_DIRECTORY\n",
+                 argv[0]);
+    return 1;
+  }
+
+  const auto files = search::generate_corpus(root, options);
+  std::printf("Wrote %zu files to %s\n", files, root);
+  return 0;
+}
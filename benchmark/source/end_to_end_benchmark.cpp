@@ -0,0 +1,176 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "corpus_generator.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+using search::corpus_options;
+
+// Generated on first use, once per run, in the temporary directory
+const fs::path& corpus(const std::string& name, const corpus_options& options)
+{
+  static std::map<std::string, fs::path> corpora;
+  auto it = corpora.find(name);
+  if (it == corpora.end()) {
+    auto root = fs::temp_directory_path() / ("fccf_benchmark_" + name);
+    fs::remove_all(root);
+    search::generate_corpus(root, options);
+    it = corpora.emplace(name, std::move(root)).first;
+  }
+  return it->second;
+}
+
+// Many files, none of which contain the query
+const fs::path& walk_corpus()
+{
+  corpus_options options;
+  options.files = 2000;
+  options.directories = 200;
+  options.include_depth = 0;
+  options.hit_rate = 0.0;
+  return corpus("walk", options);
+}
+
+// Half of the files match and are parsed, with their headers
+const fs::path& parse_corpus()
+{
+  corpus_options options;
+  options.files = 32;
+  options.directories = 4;
+  options.include_depth = 3;
+  options.hit_rate = 0.5;
+  return corpus("parse", options);
+}
+
+// Many classes with many methods, all of them named method_<n>
+const fs::path& output_corpus()
+{
+  corpus_options options;
+  options.files = 16;
+  options.directories = 2;
+  options.include_depth = 0;
+  options.classes_per_file = 16;
+  options.functions_per_class = 16;
+  return corpus("output", options);
+}
+
+// The --stats phases reported by every benchmark, in milliseconds
+const std::vector<std::pair<const char*, const char*>> phases = {
+    {"Directory walk", "walk_ms"},
+    {"File read", "read_ms"},
+    {"Prefilter", "prefilter_ms"},
+    {"Parse queue wait", "parse_queue_ms"},
+    {"clang_parseTranslationUnit", "parse_ms"},
+    {"clang_visitChildren", "visit_ms"},
+    {"Snippet formatting", "format_ms"},
+    {"Output", "output_ms"},
+    {"Results", "results"},
+};
+
+// Runs fccf with --stats, discarding its results. Returns the numbers
+// printed by --stats, by name, or an empty map if fccf failed.
+std::map<std::string, double> run_fccf(const std::string& arguments)
+{
+  const auto command = std::string {FCCF_EXECUTABLE} + " --nc --stats "
+      + arguments + " 2>&1 >/dev/null";
+  std::FILE* pipe = ::popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    return {};
+  }
+
+  std::map<std::string, double> stats;
+  char line[512];
+  while (std::fgets(line, sizeof(line), pipe) != nullptr) {
+    // "  <name>   <value>"
+    const std::string_view text {line};
+    const auto value_end = text.find_last_not_of(" \n");
+    const auto value_begin = text.find_last_of(' ', value_end);
+    const auto name_begin = text.find_first_not_of(' ');
+    if (name_begin != 2 || value_end == std::string_view::npos
+        || value_begin == std::string_view::npos || value_begin < name_begin)
+    {
+      continue;
+    }
+    const auto name_end = text.find_last_not_of(' ', value_begin);
+    const std::string value {
+        text.substr(value_begin + 1, value_end - value_begin)};
+    stats[std::string {text.substr(name_begin, name_end - name_begin + 1)}] =
+        std::strtod(value.c_str(), nullptr);
+  }
+  if (::pclose(pipe) != 0) {
+    return {};
+  }
+  return stats;
+}
+
+void run_search(benchmark::State& state, const std::string& arguments)
+{
+  const auto command =
+      "-j " + std::to_string(state.range(0)) + " " + arguments;
+
+  std::map<std::string, double> totals;
+  for (auto _ : state) {
+    const auto stats = run_fccf(command);
+    if (stats.empty()) {
+      state.SkipWithError("fccf failed");
+      return;
+    }
+    for (const auto& [name, value] : stats) {
+      totals[name] += value;
+    }
+  }
+
+  for (const auto& [name, counter] : phases) {
+    state.counters[counter] =
+        benchmark::Counter(totals[name], benchmark::Counter::kAvgIterations);
+  }
+}
+
+// 1, 2, 4 and 8 threads
+void thread_counts(benchmark::internal::Benchmark* b)
+{
+  b->RangeMultiplier(2)->Range(1, 8);
+}
+
+// Walk, read and prefilter: the query is in none of the files
+void BM_walk_and_prefilter(benchmark::State& state)
+{
+  run_search(state, "absent_query " + walk_corpus().string());
+}
+BENCHMARK(BM_walk_and_prefilter)
+    ->Apply(thread_counts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Parsing the files that pass the prefilter
+void BM_parse(benchmark::State& state)
+{
+  run_search(state, "-F needle " + parse_corpus().string());
+}
+BENCHMARK(BM_parse)
+    ->Apply(thread_counts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Formatting and writing many results
+void BM_output(benchmark::State& state)
+{
+  run_search(state, "--member-function method " + output_corpus().string());
+}
+BENCHMARK(BM_output)
+    ->Apply(thread_counts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
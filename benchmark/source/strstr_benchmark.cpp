@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <sse2_strstr.hpp>
+
+namespace
+{
+// Readable bytes after each haystack, as with file_contents
+constexpr std::size_t padding = 64;
+
+enum hit_position : std::int64_t
+{
+  no_hit,
+  hit_at_start,
+  hit_in_middle,
+  hit_at_end
+};
+
+// A haystack of "text" with the needle planted at `position`, followed by
+// `padding` zero bytes. The needle occurs nowhere else, but its first
+// characters do, so the kernels have candidates to reject.
+struct search_case
+{
+  std::vector<char> buffer;
+  std::string needle;
+
+  std::string_view haystack() const
+  {
+    return {buffer.data(), buffer.size() - padding};
+  }
+};
+
+search_case make_case(std::size_t needle_size,
+                      std::size_t haystack_size,
+                      hit_position position)
+{
+  static constexpr char alphabet[] = "etaoinshrdlu_ (){};";
+  std::uint64_t state = 0x9e3779b97f4a7c15ull;
+  const auto next_char = [&state]
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return alphabet[state % (sizeof(alphabet) - 1)];
+  };
+
+  search_case c;
+  // A character outside the alphabet keeps the needle from occurring by
+  // chance
+  c.needle.resize(needle_size);
+  for (std::size_t i = 0; i < needle_size; ++i) {
+    c.needle[i] = i + 1 == needle_size ? '#' : next_char();
+  }
+
+  c.buffer.resize(haystack_size + padding, '\0');
+  for (std::size_t i = 0; i < haystack_size; ++i) {
+    c.buffer[i] = next_char();
+  }
+  // Near misses: the needle without its last character, every 64 bytes
+  for (std::size_t i = 0; needle_size > 1 && i + needle_size <= haystack_size;
+       i += 64)
+  {
+    std::memcpy(&c.buffer[i], c.needle.data(), needle_size - 1);
+  }
+
+  if (position != no_hit && needle_size <= haystack_size) {
+    const auto last = haystack_size - needle_size;
+    const auto at = position == hit_at_start ? 0
+        : position == hit_in_middle          ? last / 2
+                                             : last;
+    std::memcpy(&c.buffer[at], c.needle.data(), needle_size);
+  }
+  return c;
+}
+
+template<typename Search>
+void run(benchmark::State& state, Search search)
+{
+  const auto c = make_case(static_cast<std::size_t>(state.range(0)),
+                           static_cast<std::size_t>(state.range(1)),
+                           static_cast<hit_position>(state.range(2)));
+  const auto haystack = c.haystack();
+  const std::string_view needle = c.needle;
+
+  const auto expected = haystack.find(needle);
+  if (search(haystack, needle) != expected) {
+    state.SkipWithError("wrong result");
+    return;
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(search(haystack, needle));
+  }
+  const auto scanned =
+      expected == std::string_view::npos ? haystack.size() : expected + 1;
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations())
+                          * static_cast<std::int64_t>(scanned));
+}
+
+void BM_simd_strstr(benchmark::State& state)
+{
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      { return search::simd_strstr(haystack, needle, padding); });
+  state.SetLabel(search::simd_strstr_kernel_name());
+}
+
+// The haystack has no uppercase letters, so case-insensitive results are
+// the same; the difference is the cost of folding
+void BM_simd_strcasestr(benchmark::State& state)
+{
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      { return search::simd_strcasestr(haystack, needle, padding); });
+  state.SetLabel(search::simd_strstr_kernel_name());
+}
+
+void BM_sse2_strstr_v2(benchmark::State& state)
+{
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      { return search::sse2_strstr_v2(haystack, needle, padding); });
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+void BM_avx2_strstr_v2(benchmark::State& state)
+{
+  if (!__builtin_cpu_supports("avx2")) {
+    state.SkipWithError("AVX2 is not supported");
+    return;
+  }
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      { return search::avx2_strstr_v2(haystack, needle, padding); });
+}
+
+void BM_avx512bw_strstr_v2(benchmark::State& state)
+{
+  if (!__builtin_cpu_supports("avx512bw")) {
+    state.SkipWithError("AVX-512BW is not supported");
+    return;
+  }
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      { return search::avx512bw_strstr_v2(haystack, needle, padding); });
+}
+#endif
+
+void BM_string_view_find(benchmark::State& state)
+{
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      { return haystack.find(needle); });
+}
+
+void BM_std_search(benchmark::State& state)
+{
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      {
+        const auto it = std::search(
+            haystack.begin(), haystack.end(), needle.begin(), needle.end());
+        return it == haystack.end()
+            ? std::string_view::npos
+            : static_cast<std::size_t>(it - haystack.begin());
+      });
+}
+
+void BM_memmem(benchmark::State& state)
+{
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      {
+        const void* found = ::memmem(
+            haystack.data(), haystack.size(), needle.data(), needle.size());
+        return found == nullptr
+            ? std::string_view::npos
+            : static_cast<std::size_t>(static_cast<const char*>(found)
+                                       - haystack.data());
+      });
+}
+
+void BM_boyer_moore_horspool(benchmark::State& state)
+{
+  run(state,
+      [](std::string_view haystack, std::string_view needle)
+      {
+        // Built per search, like a query is in fccf
+        const std::boyer_moore_horspool_searcher searcher(needle.begin(),
+                                                          needle.end());
+        const auto it =
+            std::search(haystack.begin(), haystack.end(), searcher);
+        return it == haystack.end()
+            ? std::string_view::npos
+            : static_cast<std::size_t>(it - haystack.begin());
+      });
+}
+
+// Every needle length with its own specialization (1 to 12) is covered
+// by at least one size, then a few for strstr_anysize
+void search_cases(benchmark::internal::Benchmark* b)
+{
+  b->ArgNames({"needle", "haystack", "hit"});
+  b->ArgsProduct({{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 16, 32, 64},
+                  {256, 64 << 10, 1 << 20},
+                  {no_hit, hit_in_middle}});
+  // Where the hit is matters most for short haystacks
+  for (const auto needle : {4, 16}) {
+    b->Args({needle, 256, hit_at_start});
+    b->Args({needle, 256, hit_at_end});
+  }
+}
+
+BENCHMARK(BM_simd_strstr)->Apply(search_cases);
+BENCHMARK(BM_simd_strcasestr)->Apply(search_cases);
+BENCHMARK(BM_sse2_strstr_v2)->Apply(search_cases);
+#if defined(__x86_64__) || defined(__i386__)
+BENCHMARK(BM_avx2_strstr_v2)->Apply(search_cases);
+BENCHMARK(BM_avx512bw_strstr_v2)->Apply(search_cases);
+#endif
+BENCHMARK(BM_string_view_find)->Apply(search_cases);
+BENCHMARK(BM_std_search)->Apply(search_cases);
+BENCHMARK(BM_memmem)->Apply(search_cases);
+BENCHMARK(BM_boyer_moore_horspool)->Apply(search_cases);
+
+}  // namespace
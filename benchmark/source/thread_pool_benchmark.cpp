@@ -0,0 +1,129 @@
+#include <atomic>
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+#include <thread_pool.hpp>
+#include <work_stealing_pool.hpp>
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+using search::work_stealing_pool;
+
+// 1, 2, 4, ..., 128 threads
+void thread_counts(benchmark::internal::Benchmark* b)
+{
+  b->RangeMultiplier(2)->Range(1, 128);
+}
+
+// Time from push_task() until a worker starts running the task, with the
+// pool idle in between - the cost paid by every handoff in a small search
+template<typename Pool>
+void BM_handoff_latency(benchmark::State& state)
+{
+  Pool pool(static_cast<std::uint_fast32_t>(state.range(0)));
+  std::atomic<clock_type::rep> started {0};
+
+  for (auto _ : state) {
+    const auto pushed = clock_type::now();
+    pool.push_task([&started]
+                   { started = clock_type::now().time_since_epoch().count(); });
+    pool.wait_for_tasks();
+
+    const auto latency = clock_type::duration(started.load())
+        - pushed.time_since_epoch();
+    state.SetIterationTime(
+        std::chrono::duration<double>(latency).count());
+  }
+}
+BENCHMARK_TEMPLATE(BM_handoff_latency, thread_pool)
+    ->Apply(thread_counts)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_handoff_latency, work_stealing_pool)
+    ->Apply(thread_counts)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// push_task() followed by wait_for_tasks(), e.g., searching a single file
+template<typename Pool>
+void BM_push_and_wait(benchmark::State& state)
+{
+  Pool pool(static_cast<std::uint_fast32_t>(state.range(0)));
+
+  for (auto _ : state) {
+    pool.push_task([] {});
+    pool.wait_for_tasks();
+  }
+}
+BENCHMARK_TEMPLATE(BM_push_and_wait, thread_pool)
+    ->Apply(thread_counts)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_push_and_wait, work_stealing_pool)
+    ->Apply(thread_counts)
+    ->Unit(benchmark::kMicrosecond);
+
+// Many tiny tasks pushed from outside the pool
+template<typename Pool>
+void BM_small_tasks(benchmark::State& state)
+{
+  Pool pool(static_cast<std::uint_fast32_t>(state.range(0)));
+  constexpr int tasks = 10000;
+  std::atomic<int> counter {0};
+
+  for (auto _ : state) {
+    for (int i = 0; i < tasks; ++i) {
+      pool.push_task([&counter] { counter++; });
+    }
+    pool.wait_for_tasks();
+  }
+  state.SetItemsProcessed(state.iterations() * tasks);
+}
+BENCHMARK_TEMPLATE(BM_small_tasks, thread_pool)
+    ->Apply(thread_counts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_small_tasks, work_stealing_pool)
+    ->Apply(thread_counts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Tasks that push more tasks, shaped like a directory walk: every
+// directory task pushes its subdirectories and a few tiny file tasks
+template<typename Pool>
+void walk(Pool& pool, std::atomic<int>& files, int depth)
+{
+  for (int i = 0; i < 8; ++i) {
+    pool.push_task([&files] { files++; });
+  }
+  if (depth > 0) {
+    for (int i = 0; i < 6; ++i) {
+      pool.push_task([&pool, &files, depth]
+                     { walk(pool, files, depth - 1); });
+    }
+  }
+}
+
+template<typename Pool>
+void BM_directory_walk(benchmark::State& state)
+{
+  Pool pool(static_cast<std::uint_fast32_t>(state.range(0)));
+  std::atomic<int> files {0};
+
+  for (auto _ : state) {
+    files = 0;
+    pool.push_task([&pool, &files] { walk(pool, files, 4); });
+    pool.wait_for_tasks();
+  }
+  state.SetItemsProcessed(state.iterations() * files.load());
+}
+BENCHMARK_TEMPLATE(BM_directory_walk, thread_pool)
+    ->Apply(thread_counts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_directory_walk, work_stealing_pool)
+    ->Apply(thread_counts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
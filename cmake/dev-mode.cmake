@@ -1,10 +1,16 @@
 include(cmake/folders.cmake)
 
 include(CTest)
+option(ENABLE_LIBFUZZER "Build the fuzz tests as libFuzzer targets" OFF)
 if(BUILD_TESTING)
   add_subdirectory(test)
 endif()
 
+option(BUILD_BENCHMARKS "Build the benchmarks" OFF)
+if(BUILD_BENCHMARKS)
+  add_subdirectory(benchmark)
+endif()
+
 add_custom_target(
     run-exe
     COMMAND fccf_exe
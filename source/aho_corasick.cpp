@@ -0,0 +1,138 @@
+#include <limits>
+
+#include <aho_corasick.hpp>
+
+namespace search
+{
+aho_corasick::aho_corasick(const std::vector<std::string_view>& patterns,
+                           bool ignore_case)
+    : m_pattern_count(patterns.size())
+{
+  const auto fold = [ignore_case](char c)
+  {
+    const auto byte = static_cast<unsigned char>(c);
+    return (ignore_case && byte >= 'A' && byte <= 'Z')
+        ? static_cast<unsigned char>(byte + ('a' - 'A'))
+        : byte;
+  };
+
+  // Class 0 is every byte that occurs in no pattern
+  for (const auto pattern : patterns) {
+    for (const auto c : pattern) {
+      auto& byte_class = m_class[fold(c)];
+      if (byte_class == 0) {
+        byte_class = static_cast<std::uint16_t>(m_class_count++);
+      }
+    }
+  }
+  // Both cases of a letter then take the same transitions
+  if (ignore_case) {
+    for (unsigned c = 'A'; c <= 'Z'; ++c) {
+      m_class[c] = m_class[c + ('a' - 'A')];
+    }
+  }
+  const auto classes = m_class_count;
+
+  // The trie, with missing transitions marked as absent
+  constexpr auto absent = std::numeric_limits<std::uint32_t>::max();
+  m_next.assign(classes, absent);
+  std::vector<std::vector<std::uint32_t>> outputs(1);
+  m_is_empty.resize(patterns.size());
+  for (std::uint32_t i = 0; i < patterns.size(); ++i) {
+    if (patterns[i].empty()) {
+      m_is_empty[i] = true;
+      continue;
+    }
+    std::uint32_t state = 0;
+    for (const auto c : patterns[i]) {
+      const auto transition =
+          state * classes + m_class[static_cast<unsigned char>(c)];
+      if (m_next[transition] == absent) {
+        m_next[transition] = static_cast<std::uint32_t>(outputs.size());
+        outputs.emplace_back();
+        m_next.resize(m_next.size() + classes, absent);
+      }
+      state = m_next[transition];
+    }
+    outputs[state].push_back(i);
+  }
+
+  // Breadth first, so the failure state of every state is complete
+  // before the state itself: missing transitions become the transitions
+  // of the failure state, and each state inherits its outputs
+  const auto states = outputs.size();
+  std::vector<std::uint32_t> failure(states, 0);
+  std::vector<std::uint32_t> queue;
+  queue.reserve(states);
+  for (std::size_t c = 0; c < classes; ++c) {
+    auto& next = m_next[c];
+    if (next == absent) {
+      next = 0;
+    } else {
+      queue.push_back(next);
+    }
+  }
+  for (std::size_t i = 0; i < queue.size(); ++i) {
+    const auto state = queue[i];
+    const auto* failure_next = &m_next[failure[state] * classes];
+    for (std::size_t c = 0; c < classes; ++c) {
+      auto& next = m_next[state * classes + c];
+      if (next == absent) {
+        next = failure_next[c];
+      } else {
+        failure[next] = failure_next[c];
+        const auto& inherited = outputs[failure[next]];
+        outputs[next].insert(
+            outputs[next].end(), inherited.begin(), inherited.end());
+        queue.push_back(next);
+      }
+    }
+  }
+
+  m_output_begin.reserve(states + 1);
+  for (const auto& output : outputs) {
+    m_output_begin.push_back(static_cast<std::uint32_t>(m_outputs.size()));
+    m_outputs.insert(m_outputs.end(), output.begin(), output.end());
+  }
+  m_output_begin.push_back(static_cast<std::uint32_t>(m_outputs.size()));
+}
+
+std::size_t aho_corasick::find(std::string_view text,
+                               std::vector<bool>& found) const
+{
+  std::size_t remaining = 0;
+  for (std::size_t i = 0; i < m_pattern_count; ++i) {
+    remaining += (found[i] || m_is_empty[i]) ? 0u : 1u;
+  }
+  if (m_outputs.empty() || remaining == 0) {
+    return 0;
+  }
+
+  std::size_t newly_found = 0;
+  const auto* next = m_next.data();
+  const auto* output_begin = m_output_begin.data();
+  std::uint32_t state = 0;
+  for (const auto c : text) {
+    const auto byte_class = m_class[static_cast<unsigned char>(c)];
+    state = next[state * m_class_count + byte_class];
+    const auto first = output_begin[state];
+    const auto last = output_begin[state + 1];
+    if (first == last) {
+      continue;
+    }
+    for (auto i = first; i < last; ++i) {
+      const auto pattern = m_outputs[i];
+      if (!found[pattern]) {
+        found[pattern] = true;
+        ++newly_found;
+        --remaining;
+      }
+    }
+    if (remaining == 0) {
+      break;
+    }
+  }
+  return newly_found;
+}
+
+}  // namespace search
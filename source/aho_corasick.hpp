@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace search
+{
+// Finds which of a set of patterns occur in a text, in a single pass over
+// the text (Aho and Corasick, "Efficient string matching: an aid to
+// bibliographic search", 1975). The automaton is a DFA, so each byte
+// costs one table lookup. Bytes are first mapped to classes, and every
+// byte that is in no pattern shares a class, which keeps the table small
+// enough to stay in cache for a few hundred identifiers.
+class aho_corasick
+{
+public:
+  // Empty patterns are never found. With `ignore_case`, ASCII letters
+  // match in either case: both cases of a letter share a byte class.
+  explicit aho_corasick(const std::vector<std::string_view>& patterns,
+                        bool ignore_case = false);
+
+  // Sets found[i] for every pattern i that occurs in `text`. `found` must
+  // have one entry per pattern. Returns how many entries were set that
+  // were not set before; the scan stops once every non-empty pattern is
+  // found.
+  std::size_t find(std::string_view text, std::vector<bool>& found) const;
+
+private:
+  std::array<std::uint16_t, 256> m_class {};
+  std::size_t m_class_count {1};
+  // m_next[state * m_class_count + class]; state 0 is the root
+  std::vector<std::uint32_t> m_next;
+  // The patterns that end at state s, including the ones that end at
+  // its suffixes, are m_outputs[m_output_begin[s]..m_output_begin[s + 1])
+  std::vector<std::uint32_t> m_output_begin;
+  std::vector<std::uint32_t> m_outputs;
+  std::size_t m_pattern_count {0};
+  // Never found, so the scan does not wait for them
+  std::vector<bool> m_is_empty;
+};
+
+}  // namespace search
@@ -0,0 +1,124 @@
+#include <filesystem>
+
+#include <compilation_database.hpp>
+namespace fs = std::filesystem;
+
+#include <clang-c/CXCompilationDatabase.h>  // This is libclang.
+
+namespace
+{
+std::string to_string(CXString str)
+{
+  const char* c_str = clang_getCString(str);
+  std::string result = c_str ? c_str : "";
+  clang_disposeString(str);
+  return result;
+}
+
+std::string absolute_path(const fs::path& directory, const fs::path& path)
+{
+  const auto full_path = path.is_absolute() ? path : directory / path;
+  return full_path.lexically_normal().string();
+}
+
+bool starts_with(std::string_view str, std::string_view prefix)
+{
+  return str.size() >= prefix.size()
+      && str.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Options that only make sense when the compiler actually produces
+// output. libclang ignores -c and -o, but dependency file options would
+// have it write .d files next to the build.
+bool is_output_option(std::string_view arg, bool& skip_next)
+{
+  skip_next = false;
+  if (arg == "-c" || arg == "-MD" || arg == "-MMD" || arg == "-MP") {
+    return true;
+  }
+  if (arg == "-o" || arg == "-MF" || arg == "-MT" || arg == "-MQ") {
+    skip_next = true;
+    return true;
+  }
+  // -o<path>. Other options starting with -o, e.g., -objcmt-atomic-property,
+  // have no '.' or '/' in them, unlike the paths of object files.
+  if (starts_with(arg, "-o")) {
+    return arg.find_first_of("./", 2) != std::string_view::npos;
+  }
+  return starts_with(arg, "-MF") || starts_with(arg, "-MT")
+      || starts_with(arg, "-MQ");
+}
+
+}  // namespace
+
+namespace search
+{
+bool compilation_database::load(const char* build_dir)
+{
+  CXCompilationDatabase_Error error;
+  CXCompilationDatabase database =
+      clang_CompilationDatabase_fromDirectory(build_dir, &error);
+  if (error != CXCompilationDatabase_NoError) {
+    return false;
+  }
+
+  CXCompileCommands commands =
+      clang_CompilationDatabase_getAllCompileCommands(database);
+  const unsigned num_commands = clang_CompileCommands_getSize(commands);
+  m_arguments.reserve(num_commands);
+
+  for (unsigned i = 0; i < num_commands; ++i) {
+    CXCompileCommand command = clang_CompileCommands_getCommand(commands, i);
+    const fs::path directory =
+        to_string(clang_CompileCommand_getDirectory(command));
+    const auto filename = absolute_path(
+        directory, to_string(clang_CompileCommand_getFilename(command)));
+
+    // Relative paths in the command are relative to its directory
+    std::vector<std::string> arguments {"-working-directory="
+                                        + directory.string()};
+
+    // Skip argv[0] (the compiler) and the source file itself
+    const unsigned num_args = clang_CompileCommand_getNumArgs(command);
+    bool skip_next = false;
+    for (unsigned j = 1; j < num_args; ++j) {
+      auto arg = to_string(clang_CompileCommand_getArg(command, j));
+      if (skip_next) {
+        skip_next = false;
+        continue;
+      }
+      if (is_output_option(arg, skip_next)) {
+        continue;
+      }
+      if (!starts_with(arg, "-") && absolute_path(directory, arg) == filename)
+      {
+        continue;
+      }
+      arguments.push_back(std::move(arg));
+    }
+
+    // The first entry for a file wins, like clang's own tools
+    m_arguments.emplace(filename, std::move(arguments));
+  }
+
+  clang_CompileCommands_dispose(commands);
+  clang_CompilationDatabase_dispose(database);
+  return true;
+}
+
+const std::vector<std::string>* compilation_database::find(
+    std::string_view path) const
+{
+  if (m_arguments.empty()) {
+    return nullptr;
+  }
+  const auto it = m_arguments.find(key(path));
+  return it != m_arguments.end() ? &it->second : nullptr;
+}
+
+std::string compilation_database::key(std::string_view path)
+{
+  return fs::absolute(fs::path(path)).lexically_normal().string();
+}
+
+}  // namespace search
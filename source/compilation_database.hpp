@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace search
+{
+// The clang arguments for every file listed in a compile_commands.json,
+// keyed by absolute path. Loaded once, looked up for every parsed file.
+class compilation_database
+{
+  std::unordered_map<std::string, std::vector<std::string>> m_arguments;
+
+public:
+  // Loads <build_dir>/compile_commands.json. Returns false if the
+  // database could not be loaded.
+  bool load(const char* build_dir);
+
+  // Returns the arguments for `path`, or nullptr if the file is not in
+  // the database
+  const std::vector<std::string>* find(std::string_view path) const;
+
+  // The absolute, normalized path the database is keyed by. Files in the
+  // database are parsed by this path: their arguments set the working
+  // directory to the one they are built in.
+  static std::string key(std::string_view path);
+
+  bool empty() const { return m_arguments.empty(); }
+  std::size_t size() const { return m_arguments.size(); }
+};
+
+}  // namespace search
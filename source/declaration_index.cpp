@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <declaration_index.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr char index_magic[8] = {'F', 'C', 'C', 'F', 'I', 'D', 'X', '1'};
+
+// Bumped whenever what is recorded for a cursor changes (kinds, line or
+// snippet ranges), so that old indexes are rebuilt instead of reused
+constexpr std::uint64_t index_format_version = 1;
+
+// [offset, offset + size) lies within [0, limit), without overflowing
+bool is_within(std::uint64_t offset, std::uint64_t size, std::uint64_t limit)
+{
+  return offset <= limit && size <= limit - offset;
+}
+
+}  // namespace
+
+namespace search
+{
+bool get_file_stamp(const char* path, file_stamp& stamp)
+{
+  struct stat st;
+  if (::stat(path, &st) != 0) {
+    return false;
+  }
+#if defined(__APPLE__)
+  const auto& mtime = st.st_mtimespec;
+#else
+  const auto& mtime = st.st_mtim;
+#endif
+  stamp.mtime_ns = static_cast<std::int64_t>(mtime.tv_sec) * 1000000000
+      + mtime.tv_nsec;
+  stamp.size = static_cast<std::uint64_t>(st.st_size);
+  return true;
+}
+
+std::uint64_t options_fingerprint(const std::vector<std::string>& options)
+{
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  const auto add = [&hash](unsigned char byte)
+  {
+    hash ^= byte;
+    hash *= 0x100000001b3ull;
+  };
+  for (unsigned shift = 0; shift < 64; shift += 8) {
+    add(static_cast<unsigned char>(index_format_version >> shift));
+  }
+  for (const auto& option : options) {
+    for (const auto c : option) {
+      add(static_cast<unsigned char>(c));
+    }
+    // Tells {"ab", "c"} and {"a", "bc"} apart
+    add(0);
+  }
+  return hash;
+}
+
+declaration_index::~declaration_index()
+{
+  if (m_mapping) {
+    ::munmap(m_mapping, m_mapping_size);
+  }
+}
+
+void declaration_index::open(std::string path, std::uint64_t fingerprint)
+{
+  m_path = std::move(path);
+  m_fingerprint = fingerprint;
+
+  const int fd = ::open(m_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0
+      || static_cast<std::size_t>(st.st_size) < sizeof(header))
+  {
+    ::close(fd);
+    return;
+  }
+  const auto size = static_cast<std::size_t>(st.st_size);
+  void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    return;
+  }
+
+  const auto* base = static_cast<const char*>(mapping);
+  header h;
+  std::memcpy(&h, base, sizeof(h));
+  // The counts are checked against the size before they are multiplied,
+  // so that a damaged header cannot overflow the expected size
+  std::uint64_t remaining = size - sizeof(header);
+  bool valid = std::memcmp(h.magic, index_magic, sizeof(index_magic)) == 0
+      && h.fingerprint == fingerprint
+      && h.file_count <= remaining / sizeof(file_entry);
+  if (valid) {
+    remaining -= h.file_count * sizeof(file_entry);
+    valid = h.cursor_count <= remaining / sizeof(cursor_entry);
+  }
+  if (valid) {
+    remaining -= h.cursor_count * sizeof(cursor_entry);
+    valid = h.strings_size == remaining;
+  }
+
+  const file_entry* files = nullptr;
+  const cursor_entry* cursors = nullptr;
+  const char* strings = nullptr;
+  if (valid) {
+    files = reinterpret_cast<const file_entry*>(base + sizeof(header));
+    cursors = reinterpret_cast<const cursor_entry*>(files + h.file_count);
+    strings = reinterpret_cast<const char*>(cursors + h.cursor_count);
+  }
+
+  // Every offset is used unchecked later on, so a truncated or corrupt
+  // index is rejected as a whole here
+  for (std::uint64_t i = 0; valid && i < h.file_count; ++i) {
+    const auto& entry = files[i];
+    valid = is_within(entry.path_offset, entry.path_size, h.strings_size)
+        && is_within(entry.first_cursor, entry.cursor_count, h.cursor_count);
+  }
+  for (std::uint64_t i = 0; valid && i < h.cursor_count; ++i) {
+    const auto& cursor = cursors[i];
+    valid = is_within(
+        cursor.spelling_offset, cursor.spelling_size, h.strings_size);
+  }
+  if (!valid) {
+    ::munmap(mapping, size);
+    return;
+  }
+
+  m_mapping = mapping;
+  m_mapping_size = size;
+  m_file_count = h.file_count;
+  m_files = files;
+  m_cursors = cursors;
+  m_strings = strings;
+}
+
+const declaration_index::file_entry* declaration_index::find(
+    std::string_view path) const
+{
+  const auto path_of = [this](const file_entry& entry)
+  { return std::string_view {m_strings + entry.path_offset, entry.path_size}; };
+
+  const auto* end = m_files + m_file_count;
+  const auto* it = std::lower_bound(m_files,
+                                    end,
+                                    path,
+                                    [&](const file_entry& entry,
+                                        std::string_view value)
+                                    { return path_of(entry) < value; });
+  if (it != end && path_of(*it) == path) {
+    return it;
+  }
+  return nullptr;
+}
+
+void declaration_index::update(std::string_view path,
+                               const file_stamp& stamp,
+                               const std::vector<indexed_cursor>& cursors)
+{
+  parsed_file file;
+  file.stamp = stamp;
+  file.cursors.reserve(cursors.size());
+  for (const auto& cursor : cursors) {
+    file.cursors.push_back({cursor.kind,
+                            cursor.start_line,
+                            cursor.end_line,
+                            cursor.pos,
+                            cursor.count,
+                            static_cast<std::uint32_t>(cursor.spelling.size()),
+                            file.strings.size()});
+    file.strings += cursor.spelling;
+  }
+
+  const std::scoped_lock lock(m_mutex);
+  m_parsed.insert_or_assign(std::string {path}, std::move(file));
+}
+
+bool declaration_index::save()
+{
+  const std::scoped_lock lock(m_mutex);
+  if (m_path.empty()) {
+    return true;
+  }
+
+  // Every file in the new index: either carried over from the mapped
+  // index or parsed during this run
+  struct source
+  {
+    std::string_view path;
+    const file_entry* mapped;
+    const parsed_file* parsed;
+  };
+  std::vector<source> sources;
+  sources.reserve(m_file_count + m_parsed.size());
+  bool removed = false;
+  for (std::size_t i = 0; i < m_file_count; ++i) {
+    const auto& entry = m_files[i];
+    const std::string path {m_strings + entry.path_offset, entry.path_size};
+    if (m_parsed.find(path) != m_parsed.end()) {
+      continue;
+    }
+    // Deleted files would otherwise stay in the index forever
+    if (::access(path.c_str(), F_OK) != 0) {
+      removed = true;
+      continue;
+    }
+    sources.push_back({{m_strings + entry.path_offset, entry.path_size},
+                       &entry,
+                       nullptr});
+  }
+  if (m_parsed.empty() && !removed) {
+    return true;
+  }
+  for (const auto& [path, file] : m_parsed) {
+    sources.push_back({path, nullptr, &file});
+  }
+  std::sort(sources.begin(),
+            sources.end(),
+            [](const source& lhs, const source& rhs)
+            { return lhs.path < rhs.path; });
+
+  // Spellings repeat a lot (e.g., every `size` method), so they are
+  // stored once in the string pool
+  std::string strings;
+  std::unordered_map<std::string_view, std::uint64_t> interned;
+  const auto intern = [&](std::string_view str) -> std::uint64_t
+  {
+    const auto it = interned.find(str);
+    if (it != interned.end()) {
+      return it->second;
+    }
+    const auto offset = strings.size();
+    strings += str;
+    interned.emplace(str, offset);
+    return offset;
+  };
+
+  std::vector<file_entry> files;
+  std::vector<cursor_entry> cursors;
+  files.reserve(sources.size());
+  for (const auto& src : sources) {
+    file_entry entry {};
+    entry.path_offset = strings.size();
+    entry.path_size = static_cast<std::uint32_t>(src.path.size());
+    strings += src.path;
+    entry.first_cursor = cursors.size();
+
+    if (src.mapped) {
+      entry.mtime_ns = src.mapped->mtime_ns;
+      entry.size = src.mapped->size;
+      entry.cursor_count = src.mapped->cursor_count;
+      const auto* first = m_cursors + src.mapped->first_cursor;
+      for (std::uint32_t i = 0; i < entry.cursor_count; ++i) {
+        auto cursor = first[i];
+        cursor.spelling_offset = intern(
+            {m_strings + cursor.spelling_offset, cursor.spelling_size});
+        cursors.push_back(cursor);
+      }
+    } else {
+      entry.mtime_ns = src.parsed->stamp.mtime_ns;
+      entry.size = src.parsed->stamp.size;
+      entry.cursor_count =
+          static_cast<std::uint32_t>(src.parsed->cursors.size());
+      for (auto cursor : src.parsed->cursors) {
+        cursor.spelling_offset =
+            intern({src.parsed->strings.data() + cursor.spelling_offset,
+                    cursor.spelling_size});
+        cursors.push_back(cursor);
+      }
+    }
+    files.push_back(entry);
+  }
+
+  header h {};
+  std::memcpy(h.magic, index_magic, sizeof(index_magic));
+  h.fingerprint = m_fingerprint;
+  h.file_count = files.size();
+  h.cursor_count = cursors.size();
+  h.strings_size = strings.size();
+
+  // Write next to the index and rename it into place, so that a
+  // concurrent run never maps a half-written index. Each run writes to
+  // a file of its own, so concurrent saves cannot interleave either.
+  std::string tmp_path = m_path + ".XXXXXX";
+  const int fd = ::mkstemp(tmp_path.data());
+  if (fd < 0) {
+    return false;
+  }
+  std::FILE* fp = ::fdopen(fd, "wb");
+  if (!fp) {
+    ::close(fd);
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  bool ok = std::fwrite(&h, sizeof(h), 1, fp) == 1;
+  ok = ok
+      && std::fwrite(files.data(), sizeof(file_entry), files.size(), fp)
+          == files.size();
+  ok = ok
+      && std::fwrite(cursors.data(), sizeof(cursor_entry), cursors.size(), fp)
+          == cursors.size();
+  ok = ok && std::fwrite(strings.data(), 1, strings.size(), fp) == strings.size();
+  ok = (std::fclose(fp) == 0) && ok;
+  if (!ok || std::rename(tmp_path.c_str(), m_path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  m_parsed.clear();
+  return true;
+}
+
+}  // namespace search
@@ -0,0 +1,152 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace search
+{
+// A cursor that file_search can report: its kind, the lines it spans
+// and the [pos, pos + count) range of its snippet in the file
+struct indexed_cursor
+{
+  std::uint32_t kind;
+  std::uint32_t start_line;
+  std::uint32_t end_line;
+  std::uint32_t pos;
+  std::uint32_t count;
+  std::string_view spelling;
+};
+
+// Identifies one version of a file on disk
+struct file_stamp
+{
+  std::int64_t mtime_ns;
+  std::uint64_t size;
+};
+
+bool get_file_stamp(const char* path, file_stamp& stamp);
+
+// Identifies the options files are parsed with, for declaration_index,
+// along with the index format version. FNV-1a, which unlike std::hash
+// gives the same value in every build.
+std::uint64_t options_fingerprint(const std::vector<std::string>& options);
+
+// A persistent index of the cursors found in each file, stored in a
+// single memory-mapped file:
+//
+//   header | file entries (sorted by path) | cursors | string pool
+//
+// A file's cursors are only used while its mtime and size match the
+// stamp recorded when it was parsed. Files parsed during this run are
+// merged in by save().
+class declaration_index
+{
+public:
+  struct header
+  {
+    char magic[8];
+    std::uint64_t fingerprint;
+    std::uint64_t file_count;
+    std::uint64_t cursor_count;
+    std::uint64_t strings_size;
+  };
+
+  struct file_entry
+  {
+    std::uint64_t path_offset;
+    std::uint64_t first_cursor;
+    std::int64_t mtime_ns;
+    std::uint64_t size;
+    std::uint32_t path_size;
+    std::uint32_t cursor_count;
+  };
+
+  struct cursor_entry
+  {
+    std::uint32_t kind;
+    std::uint32_t start_line;
+    std::uint32_t end_line;
+    std::uint32_t pos;
+    std::uint32_t count;
+    std::uint32_t spelling_size;
+    std::uint64_t spelling_offset;
+  };
+
+  declaration_index() = default;
+  declaration_index(const declaration_index&) = delete;
+  declaration_index& operator=(const declaration_index&) = delete;
+  ~declaration_index();
+
+  // Maps the index stored at `path`, if there is one. An index written
+  // with a different `fingerprint` (i.e., different parse options) is
+  // ignored and replaced on save().
+  void open(std::string path, std::uint64_t fingerprint);
+
+  // Calls `f` for every cursor of `path` if the index holds an up to date
+  // entry for it. Returns false if the file needs to be parsed.
+  template<typename F>
+  bool for_each_cursor(std::string_view path,
+                       const file_stamp& stamp,
+                       F&& f) const
+  {
+    const file_entry* entry = find(path);
+    if (entry == nullptr || entry->mtime_ns != stamp.mtime_ns
+        || entry->size != stamp.size)
+    {
+      return false;
+    }
+    const cursor_entry* cursors = m_cursors + entry->first_cursor;
+    for (std::uint32_t i = 0; i < entry->cursor_count; ++i) {
+      const cursor_entry& c = cursors[i];
+      f(indexed_cursor {c.kind,
+                        c.start_line,
+                        c.end_line,
+                        c.pos,
+                        c.count,
+                        {m_strings + c.spelling_offset, c.spelling_size}});
+    }
+    return true;
+  }
+
+  // Records the cursors found in a freshly parsed file. Thread-safe.
+  void update(std::string_view path,
+              const file_stamp& stamp,
+              const std::vector<indexed_cursor>& cursors);
+
+  // Writes the merged index back to disk if anything changed. Files that
+  // no longer exist are dropped from it.
+  bool save();
+
+  bool is_open() const { return !m_path.empty(); }
+
+private:
+  const file_entry* find(std::string_view path) const;
+
+  struct parsed_file
+  {
+    file_stamp stamp;
+    std::vector<cursor_entry> cursors;  // spelling_offset is into `strings`
+    std::string strings;
+  };
+
+  std::string m_path;
+  std::uint64_t m_fingerprint {0};
+
+  // The mapped index
+  void* m_mapping {nullptr};
+  std::size_t m_mapping_size {0};
+  const file_entry* m_files {nullptr};
+  std::size_t m_file_count {0};
+  const cursor_entry* m_cursors {nullptr};
+  const char* m_strings {nullptr};
+
+  // Files parsed during this run
+  std::mutex m_mutex;
+  std::unordered_map<std::string, parsed_file> m_parsed;
+};
+
+}  // namespace search
@@ -0,0 +1,164 @@
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <file_contents.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace search
+{
+const char file_contents::zeros[file_contents::padding] = {};
+
+namespace
+{
+// Buffers of small files read on this thread. A file_contents takes one
+// over and gives it back when it is destroyed.
+constexpr std::size_t max_pooled_buffers = 64;
+thread_local std::vector<std::vector<char>> pooled_buffers;
+
+bool read_fully(int fd, char* data, std::size_t size)
+{
+  while (size > 0) {
+    const auto result = ::read(fd, data, size);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    data += result;
+    size -= static_cast<std::size_t>(result);
+  }
+  return true;
+}
+
+// Maps `size` bytes of the file followed by `padding` zero bytes. The
+// bytes past the end of the file in its last page are zero already;
+// whole pages after that come from an anonymous mapping reserved first,
+// since touching file-backed pages past the end would raise SIGBUS.
+void* map_padded(int fd, std::size_t size, std::size_t& mapping_size)
+{
+  const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  mapping_size = (size + file_contents::padding + page_size - 1)
+      / page_size * page_size;
+
+  void* mapping = ::mmap(nullptr,
+                         mapping_size,
+                         PROT_READ,
+                         MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1,
+                         0);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  if (::mmap(mapping, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0)
+      == MAP_FAILED)
+  {
+    ::munmap(mapping, mapping_size);
+    return nullptr;
+  }
+  return mapping;
+}
+
+}  // namespace
+
+file_contents::file_contents(const char* path)
+{
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return;
+  }
+  const auto size = static_cast<std::size_t>(st.st_size);
+
+  if (size >= mmap_threshold) {
+    if (void* mapping = map_padded(fd, size, m_mapping_size)) {
+      ::madvise(mapping, size, MADV_SEQUENTIAL);
+      m_mapping = mapping;
+      m_data = static_cast<const char*>(mapping);
+      m_size = size;
+      ::close(fd);
+      return;
+    }
+    // Fall back to reading the file
+  }
+
+  auto buffer = buffer_for(size);
+  if (read_fully(fd, buffer.data(), size)) {
+    *this = file_contents(std::move(buffer), size);
+  }
+  ::close(fd);
+}
+
+file_contents::file_contents(std::vector<char>&& buffer, std::size_t size)
+    : m_buffer(std::move(buffer))
+{
+  std::memset(m_buffer.data() + size, 0, padding);
+  m_data = m_buffer.data();
+  m_size = size;
+}
+
+std::vector<char> file_contents::buffer_for(std::size_t size)
+{
+  std::vector<char> buffer;
+  if (!pooled_buffers.empty()) {
+    buffer = std::move(pooled_buffers.back());
+    pooled_buffers.pop_back();
+  }
+  if (buffer.size() < size + padding) {
+    buffer.clear();
+    buffer.resize(size + padding);
+  }
+  return buffer;
+}
+
+file_contents::file_contents(file_contents&& other) noexcept
+    : m_data(std::exchange(other.m_data, zeros))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_mapping(std::exchange(other.m_mapping, nullptr))
+    , m_mapping_size(std::exchange(other.m_mapping_size, 0))
+    , m_buffer(std::move(other.m_buffer))
+{
+}
+
+file_contents& file_contents::operator=(file_contents&& other) noexcept
+{
+  if (this != &other) {
+    release();
+    m_data = std::exchange(other.m_data, zeros);
+    m_size = std::exchange(other.m_size, 0);
+    m_mapping = std::exchange(other.m_mapping, nullptr);
+    m_mapping_size = std::exchange(other.m_mapping_size, 0);
+    m_buffer = std::move(other.m_buffer);
+  }
+  return *this;
+}
+
+file_contents::~file_contents()
+{
+  release();
+}
+
+void file_contents::release()
+{
+  if (m_mapping != nullptr) {
+    ::munmap(m_mapping, m_mapping_size);
+    m_mapping = nullptr;
+  }
+  if (!m_buffer.empty() && pooled_buffers.size() < max_pooled_buffers) {
+    pooled_buffers.push_back(std::move(m_buffer));
+  }
+  m_buffer = {};
+  m_data = zeros;
+  m_size = 0;
+}
+
+}  // namespace search
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace search
+{
+// The contents of a file, followed by at least `padding` zero bytes so
+// the SIMD kernels can load whole blocks at the end of the file.
+//
+// Large files are memory-mapped and never copied. Small files, where
+// setting up a mapping costs more than it saves, are read into buffers
+// that are reused by the next files read on the same thread.
+class file_contents
+{
+public:
+  static constexpr std::size_t padding = 64;
+  static constexpr std::size_t mmap_threshold = 64 * 1024;
+
+  file_contents() = default;
+
+  // Empty if the file cannot be read
+  explicit file_contents(const char* path);
+
+  // Takes over a buffer from buffer_for(size) that the first `size`
+  // bytes of a file were read into
+  file_contents(std::vector<char>&& buffer, std::size_t size);
+
+  // A buffer with room for `size` bytes and the padding
+  static std::vector<char> buffer_for(std::size_t size);
+
+  file_contents(file_contents&& other) noexcept;
+  file_contents& operator=(file_contents&& other) noexcept;
+  file_contents(const file_contents&) = delete;
+  file_contents& operator=(const file_contents&) = delete;
+
+  ~file_contents();
+
+  std::string_view view() const { return {m_data, m_size}; }
+
+private:
+  void release();
+
+  const char* m_data {zeros};
+  std::size_t m_size {0};
+
+  void* m_mapping {nullptr};
+  std::size_t m_mapping_size {0};
+  std::vector<char> m_buffer;
+
+  static const char zeros[padding];
+};
+
+}  // namespace search
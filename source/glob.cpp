@@ -0,0 +1,237 @@
+#include <glob.hpp>
+
+namespace search
+{
+glob::glob(std::string_view pattern, bool pathname)
+    : m_pathname(pathname)
+{
+  if (!pathname) {
+    m_segments.push_back(compile_segment(pattern));
+    return;
+  }
+
+  std::size_t start = 0;
+  while (true) {
+    auto end = pattern.find('/', start);
+    auto part = pattern.substr(
+        start, end == std::string_view::npos ? end : end - start);
+    if (part == "**") {
+      // Consecutive `**` components are the same as one
+      if (m_segments.empty() || !m_segments.back().globstar) {
+        segment seg;
+        seg.globstar = true;
+        m_segments.push_back(std::move(seg));
+      }
+    } else {
+      m_segments.push_back(compile_segment(part));
+    }
+    if (end == std::string_view::npos) {
+      break;
+    }
+    start = end + 1;
+  }
+}
+
+glob::segment glob::compile_segment(std::string_view pattern)
+{
+  segment seg;
+  auto& tokens = seg.tokens;
+
+  const auto append_literal = [&tokens](char c)
+  {
+    if (tokens.empty() || tokens.back().type != token_type::literal) {
+      tokens.push_back({token_type::literal, false, {}});
+    }
+    tokens.back().text += c;
+  };
+
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    const char c = pattern[i];
+    if (c == '\\' && i + 1 < pattern.size()) {
+      append_literal(pattern[++i]);
+    } else if (c == '?') {
+      tokens.push_back({token_type::any_char, false, {}});
+    } else if (c == '*') {
+      if (tokens.empty() || tokens.back().type != token_type::any_string) {
+        tokens.push_back({token_type::any_string, false, {}});
+      }
+    } else if (c == '[') {
+      // Find the closing bracket; a `]` right after `[`, `[!` or `[^`
+      // is part of the set
+      std::size_t j = i + 1;
+      bool negated = false;
+      if (j < pattern.size() && (pattern[j] == '!' || pattern[j] == '^')) {
+        negated = true;
+        ++j;
+      }
+      const auto set_begin = j;
+      if (j < pattern.size() && pattern[j] == ']') {
+        ++j;
+      }
+      while (j < pattern.size() && pattern[j] != ']') {
+        ++j;
+      }
+      if (j >= pattern.size()) {
+        // No closing bracket - match `[` literally
+        append_literal(c);
+        continue;
+      }
+
+      token t {token_type::char_class, negated, {}};
+      for (std::size_t k = set_begin; k < j; ++k) {
+        char lo = pattern[k];
+        if (lo == '\\' && k + 1 < j) {
+          lo = pattern[++k];
+        }
+        char hi = lo;
+        if (k + 2 < j && pattern[k + 1] == '-') {
+          hi = pattern[k + 2];
+          k += 2;
+        }
+        t.text += lo;
+        t.text += hi;
+      }
+      tokens.push_back(std::move(t));
+      i = j;
+    } else {
+      append_literal(c);
+    }
+  }
+  return seg;
+}
+
+bool glob::is_literal() const
+{
+  return m_segments.size() == 1 && !m_segments[0].globstar
+      && m_segments[0].tokens.size() <= 1
+      && (m_segments[0].tokens.empty()
+          || m_segments[0].tokens[0].type == token_type::literal);
+}
+
+std::string_view glob::literal() const
+{
+  return m_segments[0].tokens.empty() ? std::string_view()
+                                      : m_segments[0].tokens[0].text;
+}
+
+bool glob::is_suffix() const
+{
+  return m_segments.size() == 1 && !m_segments[0].globstar
+      && m_segments[0].tokens.size() == 2
+      && m_segments[0].tokens[0].type == token_type::any_string
+      && m_segments[0].tokens[1].type == token_type::literal;
+}
+
+std::string_view glob::suffix() const
+{
+  return m_segments[0].tokens[1].text;
+}
+
+bool glob::match_char(const token& t, char c)
+{
+  if (t.type == token_type::any_char) {
+    return true;
+  }
+  bool in_set = false;
+  for (std::size_t i = 0; i + 1 < t.text.size(); i += 2) {
+    if (t.text[i] <= c && c <= t.text[i + 1]) {
+      in_set = true;
+      break;
+    }
+  }
+  return in_set != t.negated;
+}
+
+// Greedy matching with backtracking to the last `*` only, which is
+// enough since a `*` here never has to stop at a separator
+bool glob::match_segment(const segment& seg,
+                         std::string_view text,
+                         bool pathname)
+{
+  const auto& tokens = seg.tokens;
+  std::size_t ti = 0, si = 0;
+  std::size_t star_ti = std::string_view::npos, star_si = 0;
+
+  while (si < text.size() || ti < tokens.size()) {
+    if (ti < tokens.size()) {
+      const auto& t = tokens[ti];
+      switch (t.type) {
+        case token_type::literal:
+          if (text.compare(si, t.text.size(), t.text) == 0) {
+            si += t.text.size();
+            ++ti;
+            continue;
+          }
+          break;
+        case token_type::any_char:
+        case token_type::char_class:
+          if (si < text.size() && !(pathname && text[si] == '/')
+              && match_char(t, text[si]))
+          {
+            ++si;
+            ++ti;
+            continue;
+          }
+          break;
+        case token_type::any_string:
+          star_ti = ti++;
+          star_si = si;
+          continue;
+      }
+    }
+    // Mismatch: let the last `*` swallow one more character
+    if (star_ti == std::string_view::npos || star_si >= text.size()
+        || (pathname && text[star_si] == '/'))
+    {
+      return false;
+    }
+    ti = star_ti + 1;
+    si = ++star_si;
+  }
+  return true;
+}
+
+bool glob::match_segments(std::size_t pattern_index,
+                          std::string_view text) const
+{
+  if (pattern_index == m_segments.size()) {
+    return text.empty();
+  }
+
+  const auto& seg = m_segments[pattern_index];
+  if (seg.globstar) {
+    // Try swallowing zero, one, two, ... leading components
+    while (true) {
+      if (match_segments(pattern_index + 1, text)) {
+        return true;
+      }
+      const auto slash = text.find('/');
+      if (slash == std::string_view::npos) {
+        // A trailing `**` matches everything below, but not nothing
+        return pattern_index + 1 == m_segments.size() && !text.empty();
+      }
+      text.remove_prefix(slash + 1);
+    }
+  }
+
+  const auto slash = text.find('/');
+  const auto component = text.substr(0, slash);
+  if (!match_segment(seg, component, true)) {
+    return false;
+  }
+  if (slash == std::string_view::npos) {
+    return pattern_index + 1 == m_segments.size();
+  }
+  return pattern_index + 1 < m_segments.size()
+      && match_segments(pattern_index + 1, text.substr(slash + 1));
+}
+
+bool glob::matches(std::string_view text) const
+{
+  if (!m_pathname) {
+    return match_segment(m_segments[0], text, false);
+  }
+  return match_segments(0, text);
+}
+
+}  // namespace search
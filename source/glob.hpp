@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace search
+{
+// A glob pattern compiled once and matched many times, without going
+// through fnmatch for every path.
+//
+// Supports `?`, `*`, `[...]` (ranges and `!`/`^` negation) and `\`
+// escapes. With `pathname` set, `*` and `?` do not match `/` and a
+// `**` path component matches any number of directories (gitignore
+// semantics). Without it, `/` is an ordinary character, like
+// fnmatch(pattern, path, 0).
+class glob
+{
+public:
+  glob() = default;
+  explicit glob(std::string_view pattern, bool pathname = false);
+
+  bool matches(std::string_view text) const;
+
+  // True if the pattern is a plain string without any wildcards, which
+  // is returned by literal()
+  bool is_literal() const;
+  std::string_view literal() const;
+
+  // True for `*<literal>` patterns, e.g., `*.o`. The literal is
+  // returned by suffix().
+  bool is_suffix() const;
+  std::string_view suffix() const;
+
+private:
+  enum class token_type : std::uint8_t
+  {
+    literal,
+    any_char,
+    any_string,
+    char_class
+  };
+
+  struct token
+  {
+    token_type type;
+    bool negated;  // char_class only
+    std::string text;  // literal text, or char_class as (lo, hi) pairs
+  };
+
+  // A path component (or the whole pattern without `pathname`)
+  struct segment
+  {
+    bool globstar {false};
+    std::vector<token> tokens;
+  };
+
+  static segment compile_segment(std::string_view pattern);
+  static bool match_segment(const segment& seg,
+                            std::string_view text,
+                            bool pathname);
+  static bool match_char(const token& t, char c);
+  bool match_segments(std::size_t pattern_index, std::string_view text) const;
+
+  bool m_pathname {false};
+  std::vector<segment> m_segments;
+};
+
+}  // namespace search
@@ -0,0 +1,244 @@
+#include <cstdio>
+#include <filesystem>
+
+#include <ignore_rules.hpp>
+namespace fs = std::filesystem;
+
+namespace
+{
+std::string read_file(const std::string& path)
+{
+  std::string contents;
+  std::FILE* fp = std::fopen(path.c_str(), "rb");
+  if (fp) {
+    char buffer[4096];
+    std::size_t size;
+    while ((size = std::fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+      contents.append(buffer, size);
+    }
+    std::fclose(fp);
+  }
+  return contents;
+}
+
+// `*.ext` with a single dot, e.g., `*.o`, but not `*.tar.gz`
+bool is_extension_pattern(const search::glob& pattern)
+{
+  if (!pattern.is_suffix()) {
+    return false;
+  }
+  const auto suffix = pattern.suffix();
+  return suffix.size() > 1 && suffix[0] == '.'
+      && suffix.find('.', 1) == std::string_view::npos;
+}
+
+}  // namespace
+
+namespace search
+{
+void ignore_rules::add_file(const std::string& path)
+{
+  add_patterns(read_file(path));
+}
+
+void ignore_rules::add_patterns(std::string_view contents)
+{
+  while (!contents.empty()) {
+    auto end = contents.find('\n');
+    auto line = contents.substr(0, end);
+    contents.remove_prefix(end == std::string_view::npos ? contents.size()
+                                                         : end + 1);
+
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    // Trailing spaces are ignored unless escaped
+    while (!line.empty() && line.back() == ' '
+           && !(line.size() > 1 && line[line.size() - 2] == '\\'))
+    {
+      line.remove_suffix(1);
+    }
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    rule r {glob(), false, false, false};
+    if (line[0] == '!') {
+      r.negated = true;
+      line.remove_prefix(1);
+    } else if (line.size() > 1 && (line[0] == '\\')
+               && (line[1] == '!' || line[1] == '#'))
+    {
+      line.remove_prefix(1);
+    }
+    if (!line.empty() && line.back() == '/') {
+      r.dir_only = true;
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      continue;
+    }
+    // A slash at the beginning or in the middle anchors the pattern to
+    // this directory; otherwise it matches a name at any depth
+    if (line.find('/') != std::string_view::npos) {
+      r.anchored = true;
+      if (line[0] == '/') {
+        line.remove_prefix(1);
+      }
+    }
+    r.pattern = glob(line, true);
+
+    m_has_negation = m_has_negation || r.negated;
+    m_has_anchored = m_has_anchored || r.anchored;
+    m_rules.push_back(std::move(r));
+  }
+
+  if (m_has_negation) {
+    return;
+  }
+  // m_other_rules points into m_rules, which may have been reallocated
+  m_names.clear();
+  m_dir_names.clear();
+  m_extensions.clear();
+  m_other_rules.clear();
+  for (const auto& r : m_rules) {
+    if (!r.anchored && r.pattern.is_literal()) {
+      const std::string name {r.pattern.literal()};
+      (r.dir_only ? m_dir_names : m_names).insert(name);
+    } else if (!r.anchored && !r.dir_only && is_extension_pattern(r.pattern))
+    {
+      m_extensions.emplace(r.pattern.suffix());
+    } else {
+      m_other_rules.push_back(&r);
+    }
+  }
+}
+
+ignore_rules::result ignore_rules::match(std::string_view name,
+                                         std::string_view relative_path,
+                                         bool is_dir) const
+{
+  const auto rule_matches = [&](const rule& r)
+  {
+    return (!r.dir_only || is_dir)
+        && r.pattern.matches(r.anchored ? relative_path : name);
+  };
+
+  if (m_has_negation) {
+    // The last matching pattern decides
+    for (auto it = m_rules.rbegin(); it != m_rules.rend(); ++it) {
+      if (rule_matches(*it)) {
+        return it->negated ? result::whitelisted : result::ignored;
+      }
+    }
+    return result::none;
+  }
+
+  const std::string key {name};
+  if (m_names.count(key) != 0 || (is_dir && m_dir_names.count(key) != 0)) {
+    return result::ignored;
+  }
+  if (!m_extensions.empty()) {
+    const auto dot = name.rfind('.');
+    if (dot != std::string_view::npos
+        && m_extensions.count(std::string {name.substr(dot)}) != 0)
+    {
+      return result::ignored;
+    }
+  }
+  for (const auto* r : m_other_rules) {
+    if (rule_matches(*r)) {
+      return result::ignored;
+    }
+  }
+  return result::none;
+}
+
+bool is_ignored(const ignore_context* context,
+                std::string_view path,
+                std::string_view name,
+                bool is_dir)
+{
+  // Rules closer to the entry take precedence
+  for (; context != nullptr; context = context->parent.get()) {
+    if (context->rules.empty()) {
+      continue;
+    }
+    std::string relative_path;
+    if (context->rules.has_anchored()) {
+      auto relative = path.substr(context->base.size());
+      if (!relative.empty() && relative[0] == '/') {
+        relative.remove_prefix(1);
+      }
+      relative_path = context->prefix;
+      relative_path += relative;
+    }
+    switch (context->rules.match(name, relative_path, is_dir)) {
+      case ignore_rules::result::ignored:
+        return true;
+      case ignore_rules::result::whitelisted:
+        return false;
+      case ignore_rules::result::none:
+        break;
+    }
+  }
+  return false;
+}
+
+std::shared_ptr<const ignore_context> root_ignore_context(
+    const std::string& root)
+{
+  std::error_code ec;
+  auto root_path = fs::absolute(root, ec).lexically_normal();
+  if (ec) {
+    return nullptr;
+  }
+  // "." and "dir/" normalize to a trailing separator, whose parent_path
+  // is the root itself; it would be read again as its own ancestor
+  if (!root_path.has_filename() && root_path != root_path.root_path()) {
+    root_path = root_path.parent_path();
+  }
+
+  // Find the top of the repository the root is in, if any. The root's
+  // own files are read when the root is walked.
+  std::vector<fs::path> ancestors;
+  bool in_git_repo = false;
+  if (fs::exists(root_path / ".git", ec)) {
+    return nullptr;
+  }
+  for (auto dir = root_path.parent_path();; dir = dir.parent_path()) {
+    if (dir.empty()) {
+      break;
+    }
+    ancestors.push_back(dir);
+    if (fs::exists(dir / ".git", ec)) {
+      in_git_repo = true;
+      break;
+    }
+    if (dir == dir.root_path()) {
+      break;
+    }
+  }
+  if (!in_git_repo) {
+    // Outside of a repository only the root's own .ignore files count
+    return nullptr;
+  }
+
+  std::shared_ptr<const ignore_context> context;
+  for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it) {
+    auto next = std::make_shared<ignore_context>();
+    next->parent = context;
+    next->base = root;
+    next->prefix = root_path.lexically_relative(*it).generic_string() + '/';
+    next->in_git_repo = true;
+    if (it == ancestors.rbegin()) {
+      next->rules.add_file((*it / ".git" / "info" / "exclude").string());
+    }
+    next->rules.add_file((*it / ".gitignore").string());
+    next->rules.add_file((*it / ".ignore").string());
+    context = std::move(next);
+  }
+  return context;
+}
+
+}  // namespace search
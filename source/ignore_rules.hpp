@@ -0,0 +1,88 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include <glob.hpp>
+
+namespace search
+{
+// The patterns of the .gitignore/.ignore files found in one directory,
+// compiled once when the directory is read
+class ignore_rules
+{
+public:
+  enum class result
+  {
+    none,
+    ignored,
+    whitelisted  // matched a `!pattern`
+  };
+
+  // Appends the patterns in `path`, if the file exists. Later patterns
+  // take precedence over earlier ones.
+  void add_file(const std::string& path);
+  void add_patterns(std::string_view contents);
+
+  // `relative_path` is the path of the entry relative to the directory
+  // the patterns were read from; it is only looked at by patterns that
+  // contain a `/`
+  result match(std::string_view name,
+               std::string_view relative_path,
+               bool is_dir) const;
+
+  bool empty() const { return m_rules.empty(); }
+  bool has_anchored() const { return m_has_anchored; }
+
+private:
+  struct rule
+  {
+    glob pattern;
+    bool negated;
+    bool dir_only;
+    bool anchored;
+  };
+
+  std::vector<rule> m_rules;
+  bool m_has_negation {false};
+  bool m_has_anchored {false};
+
+  // Without negations the order of the rules does not matter, so the
+  // common patterns (`name`, `name/`, `*.ext`) become hash lookups and
+  // only the rest are matched one by one
+  std::unordered_set<std::string> m_names;
+  std::unordered_set<std::string> m_dir_names;
+  std::unordered_set<std::string> m_extensions;
+  std::vector<const rule*> m_other_rules;
+};
+
+// The ignore rules in effect for a directory: its own, then those of its
+// parents. Shared by every directory below it.
+struct ignore_context
+{
+  std::shared_ptr<const ignore_context> parent;
+
+  // The walked path that paths are made relative to, and what to put in
+  // front of them (only set for rules read from above the search root)
+  std::string base;
+  std::string prefix;
+
+  ignore_rules rules;
+
+  // .gitignore files only count inside a git repository
+  bool in_git_repo {false};
+};
+
+bool is_ignored(const ignore_context* context,
+                std::string_view path,
+                std::string_view name,
+                bool is_dir);
+
+// Builds the context for a search root: the .gitignore/.ignore files of
+// the directories above it, up to the top of its git repository
+std::shared_ptr<const ignore_context> root_ignore_context(
+    const std::string& root);
+
+}  // namespace search
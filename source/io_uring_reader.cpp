@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <io_uring_reader.hpp>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#  define FCCF_HAS_IO_URING 1
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#endif
+
+namespace search
+{
+namespace
+{
+void read_files_synchronously(const std::vector<std::string>& paths,
+                              const file_contents_callback& callback)
+{
+  for (const auto& path : paths) {
+    callback(path, file_contents(path.c_str()));
+  }
+}
+
+#if defined(FCCF_HAS_IO_URING)
+
+// A minimal io_uring submission/completion ring, driven through the raw
+// system calls. Only the thread that created it may use it.
+class ring
+{
+public:
+  ring()
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    m_fd = static_cast<int>(
+        ::syscall(__NR_io_uring_setup, read_batch_size, &params));
+    if (m_fd < 0) {
+      return;
+    }
+    // Kernels without a single mapping for both rings also lack
+    // IORING_OP_OPENAT and IORING_OP_READ
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0
+        || !supports_operations())
+    {
+      close_ring();
+      return;
+    }
+
+    m_rings_size = std::max(
+        params.sq_off.array + params.sq_entries * sizeof(unsigned),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    m_rings = ::mmap(nullptr,
+                     m_rings_size,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE,
+                     m_fd,
+                     IORING_OFF_SQ_RING);
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr,
+                        m_sqes_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        m_fd,
+                        IORING_OFF_SQES);
+    if (m_rings == MAP_FAILED || sqes == MAP_FAILED) {
+      if (m_rings != MAP_FAILED) {
+        ::munmap(m_rings, m_rings_size);
+      }
+      if (sqes != MAP_FAILED) {
+        ::munmap(sqes, m_sqes_size);
+      }
+      m_rings = nullptr;
+      close_ring();
+      return;
+    }
+
+    auto* rings = static_cast<char*>(m_rings);
+    m_sq_head = reinterpret_cast<unsigned*>(rings + params.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned*>(rings + params.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<unsigned*>(rings + params.sq_off.ring_mask);
+    m_sq_entries = params.sq_entries;
+    m_sq_array = reinterpret_cast<unsigned*>(rings + params.sq_off.array);
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+    m_cq_head = reinterpret_cast<unsigned*>(rings + params.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*>(rings + params.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<unsigned*>(rings + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(rings + params.cq_off.cqes);
+  }
+
+  ring(const ring&) = delete;
+  ring& operator=(const ring&) = delete;
+
+  ~ring()
+  {
+    if (m_rings != nullptr) {
+      ::munmap(m_sqes, m_sqes_size);
+      ::munmap(m_rings, m_rings_size);
+    }
+    close_ring();
+  }
+
+  bool is_open() const { return m_fd >= 0; }
+
+  // Stops using the ring after io_uring_enter failed. Later batches are
+  // read with file_contents.
+  void abandon() { close_ring(); }
+
+  // Keeps a buffer the kernel may still write to until the ring is gone
+  void keep_alive(std::vector<char>&& buffer)
+  {
+    m_abandoned_buffers.push_back(std::move(buffer));
+  }
+
+  // Queues a request; it is sent to the kernel by the next submit().
+  // Returns nullptr if the submission queue is full.
+  io_uring_sqe* next_sqe(std::uint8_t opcode, std::uint64_t user_data)
+  {
+    const unsigned tail = *m_sq_tail + m_queued;
+    if (tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries)
+    {
+      return nullptr;
+    }
+    const unsigned index = tail & m_sq_mask;
+    io_uring_sqe* sqe = &m_sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = user_data;
+    m_sq_array[index] = index;
+    ++m_queued;
+    return sqe;
+  }
+
+  // Sends the queued requests and waits until at least `wait_for`
+  // completions are available
+  bool submit(unsigned wait_for)
+  {
+    __atomic_store_n(m_sq_tail, *m_sq_tail + m_queued, __ATOMIC_RELEASE);
+    unsigned to_submit = m_queued;
+    m_queued = 0;
+    for (;;) {
+      const int result =
+          static_cast<int>(::syscall(__NR_io_uring_enter,
+                                     m_fd,
+                                     to_submit,
+                                     wait_for,
+                                     wait_for > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                     nullptr,
+                                     0));
+      if (result >= 0) {
+        return true;
+      }
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        return false;
+      }
+      if (errno == EINTR) {
+        // Interrupted while waiting; the requests were already submitted
+        to_submit = 0;
+      }
+    }
+  }
+
+  // Calls `f(user_data, result)` for each available completion
+  template<typename F>
+  unsigned reap(F&& f)
+  {
+    unsigned head = *m_cq_head;
+    const unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+    for (; head != tail; ++head, ++count) {
+      const io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+      f(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    return count;
+  }
+
+private:
+  bool supports_operations() const
+  {
+    std::vector<char> storage(sizeof(io_uring_probe)
+                              + IORING_OP_LAST * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    if (::syscall(__NR_io_uring_register,
+                  m_fd,
+                  IORING_REGISTER_PROBE,
+                  probe,
+                  IORING_OP_LAST)
+        < 0)
+    {
+      return false;
+    }
+    for (const auto op : {IORING_OP_OPENAT, IORING_OP_READ}) {
+      if (op > probe->last_op
+          || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void close_ring()
+  {
+    if (m_fd >= 0) {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+  int m_fd {-1};
+  void* m_rings {nullptr};
+  std::size_t m_rings_size {0};
+  std::size_t m_sqes_size {0};
+
+  unsigned* m_sq_head {nullptr};
+  unsigned* m_sq_tail {nullptr};
+  unsigned m_sq_mask {0};
+  unsigned m_sq_entries {0};
+  unsigned* m_sq_array {nullptr};
+  io_uring_sqe* m_sqes {nullptr};
+  unsigned m_queued {0};
+
+  unsigned* m_cq_head {nullptr};
+  unsigned* m_cq_tail {nullptr};
+  unsigned m_cq_mask {0};
+  io_uring_cqe* m_cqes {nullptr};
+
+  std::vector<std::vector<char>> m_abandoned_buffers;
+};
+
+struct pending_file
+{
+  const std::string* path;
+  int fd;
+  std::size_t size;
+  std::vector<char> buffer;
+  bool in_flight;
+  bool done;
+};
+
+// Submits the requests queued on `r` and collects `count` completions,
+// calling `f(index, result)` for each as it arrives
+template<typename F>
+bool complete(ring& r, unsigned count, F&& f)
+{
+  if (count == 0) {
+    return true;
+  }
+  if (!r.submit(0)) {
+    return false;
+  }
+  while (count > 0) {
+    const auto reaped = r.reap(f);
+    count -= reaped;
+    if (count > 0 && reaped == 0 && !r.submit(1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void read_batch(ring& r,
+                const std::vector<std::string>& paths,
+                std::size_t first,
+                std::size_t last,
+                const file_contents_callback& callback)
+{
+  std::vector<pending_file> files;
+  files.reserve(last - first);
+  for (auto i = first; i < last; ++i) {
+    files.push_back({&paths[i], -1, 0, {}, false, false});
+  }
+
+  // Open every file of the batch at once
+  unsigned queued = 0;
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    io_uring_sqe* sqe = r.next_sqe(IORING_OP_OPENAT, i);
+    if (sqe == nullptr) {
+      break;
+    }
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<std::uint64_t>(files[i].path->c_str());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    ++queued;
+  }
+  const auto record_fd = [&](std::uint64_t index, int result)
+  { files[index].fd = result; };
+  const bool opened = complete(r, queued, record_fd);
+  if (!opened) {
+    // Opens that completed before io_uring_enter failed may not have
+    // been reaped yet. Their files are closed too, so that none is left
+    // open while the batch is read again below.
+    r.reap(record_fd);
+    r.abandon();
+    for (auto& file : files) {
+      if (file.fd >= 0) {
+        ::close(file.fd);
+        file.fd = -1;
+      }
+    }
+  }
+
+  // Then read the small ones into their buffers. Large files are mapped
+  // by file_contents instead.
+  queued = 0;
+  for (std::size_t i = 0; opened && i < files.size(); ++i) {
+    auto& file = files[i];
+    struct stat st;
+    if (file.fd < 0 || ::fstat(file.fd, &st) != 0 || st.st_size <= 0
+        || static_cast<std::size_t>(st.st_size)
+            >= file_contents::mmap_threshold)
+    {
+      continue;
+    }
+    io_uring_sqe* sqe = r.next_sqe(IORING_OP_READ, i);
+    if (sqe == nullptr) {
+      continue;
+    }
+    file.size = static_cast<std::size_t>(st.st_size);
+    file.buffer = file_contents::buffer_for(file.size);
+    file.in_flight = true;
+    sqe->fd = file.fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(file.buffer.data());
+    sqe->len = static_cast<std::uint32_t>(file.size);
+    sqe->off = 0;
+    ++queued;
+  }
+
+  // Each file is searched as soon as it arrives, while the others are
+  // still being read
+  const bool read = complete(
+      r,
+      queued,
+      [&](std::uint64_t index, int result)
+      {
+        auto& file = files[index];
+        file.in_flight = false;
+        if (result >= 0 && static_cast<std::size_t>(result) == file.size) {
+          file.done = true;
+          callback(*file.path,
+                   file_contents(std::move(file.buffer), file.size));
+        }
+      });
+
+  if (!read) {
+    r.abandon();
+  }
+  // Every descriptor of the batch is closed before any file is read
+  // again, rather than held open through the callbacks below
+  for (auto& file : files) {
+    if (file.in_flight) {
+      r.keep_alive(std::move(file.buffer));
+    }
+    if (file.fd >= 0) {
+      ::close(file.fd);
+    }
+  }
+  for (auto& file : files) {
+    // Failed, short or never queued; read like any other file
+    if (!file.done) {
+      callback(*file.path, file_contents(file.path->c_str()));
+    }
+  }
+}
+
+#endif
+
+}  // namespace
+
+bool io_uring_available()
+{
+#if defined(FCCF_HAS_IO_URING)
+  static const bool available = ring().is_open();
+  return available;
+#else
+  return false;
+#endif
+}
+
+void read_files(const std::vector<std::string>& paths,
+                const file_contents_callback& callback)
+{
+#if defined(FCCF_HAS_IO_URING)
+  if (io_uring_available()) {
+    thread_local ring this_thread_ring;
+    if (this_thread_ring.is_open()) {
+      for (std::size_t first = 0; first < paths.size();
+           first += read_batch_size)
+      {
+        const auto last = std::min(paths.size(), first + read_batch_size);
+        read_batch(this_thread_ring, paths, first, last, callback);
+      }
+      return;
+    }
+  }
+#endif
+  read_files_synchronously(paths, callback);
+}
+
+}  // namespace search
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <file_contents.hpp>
+
+namespace search
+{
+using file_contents_callback =
+    std::function<void(const std::string& path, file_contents contents)>;
+
+// The number of files read_files has in flight at once
+constexpr std::size_t read_batch_size = 32;
+
+// Reads a batch of files with io_uring: the opens of the whole batch are
+// submitted at once, then the reads, so the disk always has the batch's
+// requests queued instead of one blocking read per thread. Each file is
+// handed to `callback` as soon as its read completes, while the rest are
+// still in flight.
+//
+// Files the ring cannot handle (large ones, which are memory-mapped, or
+// any that fail) are read with file_contents on the calling thread.
+// Without io_uring support, all of them are.
+void read_files(const std::vector<std::string>& paths,
+                const file_contents_callback& callback);
+
+// True if io_uring can be used on this system, checked once
+bool io_uring_available();
+
+}  // namespace search
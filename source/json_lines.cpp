@@ -0,0 +1,135 @@
+#include <iterator>
+
+#include <json_lines.hpp>
+
+namespace
+{
+// The length of the UTF-8 sequence at the start of `s`, or 0 if it is
+// not valid (including overlong forms and surrogates)
+std::size_t utf8_sequence_length(std::string_view s)
+{
+  const auto byte = [&](std::size_t i)
+  { return static_cast<unsigned char>(s[i]); };
+  const auto is_continuation = [&](std::size_t i)
+  { return i < s.size() && (byte(i) & 0xC0) == 0x80; };
+
+  const auto lead = byte(0);
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    return is_continuation(1) ? 2 : 0;
+  }
+  if (lead >= 0xE0 && lead <= 0xEF) {
+    if (!is_continuation(1) || !is_continuation(2)) {
+      return 0;
+    }
+    if ((lead == 0xE0 && byte(1) < 0xA0) || (lead == 0xED && byte(1) > 0x9F))
+    {
+      return 0;
+    }
+    return 3;
+  }
+  if (lead >= 0xF0 && lead <= 0xF4) {
+    if (!is_continuation(1) || !is_continuation(2) || !is_continuation(3)) {
+      return 0;
+    }
+    if ((lead == 0xF0 && byte(1) < 0x90) || (lead == 0xF4 && byte(1) > 0x8F))
+    {
+      return 0;
+    }
+    return 4;
+  }
+  return 0;
+}
+
+}  // namespace
+
+namespace search
+{
+void append_json_string(fmt::memory_buffer& out, std::string_view text)
+{
+  static constexpr char hex_digits[] = "0123456789abcdef";
+
+  out.push_back('"');
+  std::size_t i = 0;
+  while (i < text.size()) {
+    // Copy the run of characters that need no escaping in one go
+    auto run = i;
+    while (run < text.size()) {
+      const auto c = static_cast<unsigned char>(text[run]);
+      if (c < 0x20 || c == '"' || c == '\\' || c >= 0x80) {
+        break;
+      }
+      ++run;
+    }
+    out.append(text.data() + i, text.data() + run);
+    i = run;
+    if (i == text.size()) {
+      break;
+    }
+
+    const auto c = static_cast<unsigned char>(text[i]);
+    if (c >= 0x80) {
+      const auto length = utf8_sequence_length(text.substr(i));
+      if (length == 0) {
+        out.append(std::string_view {"\\ufffd"});
+        ++i;
+      } else {
+        out.append(text.data() + i, text.data() + i + length);
+        i += length;
+      }
+      continue;
+    }
+
+    out.push_back('\\');
+    switch (c) {
+      case '"':
+        out.push_back('"');
+        break;
+      case '\\':
+        out.push_back('\\');
+        break;
+      case '\b':
+        out.push_back('b');
+        break;
+      case '\f':
+        out.push_back('f');
+        break;
+      case '\n':
+        out.push_back('n');
+        break;
+      case '\r':
+        out.push_back('r');
+        break;
+      case '\t':
+        out.push_back('t');
+        break;
+      default:
+        out.append(std::string_view {"u00"});
+        out.push_back(hex_digits[c >> 4]);
+        out.push_back(hex_digits[c & 0xF]);
+        break;
+    }
+    ++i;
+  }
+  out.push_back('"');
+}
+
+void append_json_line(fmt::memory_buffer& out,
+                      std::string_view filename,
+                      unsigned start_line,
+                      unsigned end_line,
+                      std::string_view code_snippet,
+                      std::size_t query_id)
+{
+  fmt::format_to(std::back_inserter(out), "{{\"end_line\":{},", end_line);
+  out.append(std::string_view {"\"filename\":"});
+  append_json_string(out, filename);
+  if (query_id != 0) {
+    fmt::format_to(std::back_inserter(out), ",\"query_id\":{}", query_id);
+  }
+  out.append(std::string_view {",\"snippet\":"});
+  append_json_string(out, code_snippet);
+  fmt::format_to(
+      std::back_inserter(out), ",\"start_line\":{}}}\n", start_line);
+}
+
+}  // namespace search
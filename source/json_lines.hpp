@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+#include <fmt/format.h>
+
+namespace search
+{
+// Appends `text` to `out` as a JSON string literal, quotes included.
+// Invalid UTF-8 is replaced with U+FFFD, so the output is always valid
+// JSON.
+void append_json_string(fmt::memory_buffer& out, std::string_view text);
+
+// Appends one result as a single-line JSON object, with the same keys as
+// --json, followed by a newline. The query_id key is left out for 0.
+void append_json_line(fmt::memory_buffer& out,
+                      std::string_view filename,
+                      unsigned start_line,
+                      unsigned end_line,
+                      std::string_view code_snippet,
+                      std::size_t query_id = 0);
+
+}  // namespace search
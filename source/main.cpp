@@ -1,60 +1,48 @@
+#include <algorithm>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include <argparse.hpp>
+#include <json_lines.hpp>
 #include <searcher.hpp>
+#include <stats.hpp>
 #include <unistd.h>
 
 #include <nlohmann/json.hpp>
 
 namespace fs = std::filesystem;
 
-int main(int argc, char* argv[])
+namespace
+{
+// The flags that say what a query looks for. They are given on the
+// command line, or in front of each query in a --queries-from file.
+void add_query_arguments(argparse::ArgumentParser& program)
 {
-  auto is_stdout = isatty(STDOUT_FILENO) == 1;
-  std::ios_base::sync_with_stdio(false);
-  std::cin.tie(NULL);
-  argparse::ArgumentParser program("fccf", "0.6.0");
-  program.add_argument("query");
-  program.add_argument("path").remaining();
-
-  // Generic Program Information
-  program.add_argument("-h", "--help")
-      .help("Shows help message and exits")
-      .default_value(false)
-      .implicit_value(true);
-
   program.add_argument("-E", "--exact-match")
       .help("Only consider exact matches")
       .default_value(false)
       .implicit_value(true);
 
-  program.add_argument("--json")
-      .help("Print results in JSON format")
+  program.add_argument("--regex")
+      .help(
+          "Treat the query as a regular expression, e.g., `^get.*Handler$` "
+          "or `(Read|Write)Buffer`. With -E it has to match the whole name")
       .default_value(false)
       .implicit_value(true);
 
-  program.add_argument("-f", "--filter")
-      .help("Only evaluate files that match filter pattern")
-      .default_value(std::string {"*.*"});
-
-  program.add_argument("--no-ignore-dirs")
+  program.add_argument("-i", "--ignore-case")
       .help(
-          "Do not ignore files under an integrated list of blocklisted "
-          "directories (VCS, IDE, common build directories, etc.)")
+          "Match ASCII letters in either case, e.g., `httpclient` finds "
+          "`HttpClient`")
       .default_value(false)
       .implicit_value(true);
 
-  program.add_argument("-j")
-      .help("Number of threads")
-      .scan<'d', int>()
-      .default_value(5);
-
   program.add_argument("--enum")
       .help("Search for enum declaration")
       .default_value(false)
@@ -149,11 +137,6 @@ int main(int argc, char* argv[])
       .default_value(false)
       .implicit_value(true);
 
-  program.add_argument("--verbose")
-      .help("Request verbose output")
-      .default_value(false)
-      .implicit_value(true);
-
   program.add_argument("--ie", "--include-expressions")
       .help(
           "Search for expressions that refer to some value or "
@@ -192,17 +175,382 @@ int main(int argc, char* argv[])
       .help("Search for throw expression")
       .default_value(false)
       .implicit_value(true);
+}
+
+// Every flag of add_query_arguments
+constexpr const char* query_flags[] = {
+    "--exact-match",          "--regex",
+    "--ignore-case",          "--enum",
+    "--struct",               "--union",
+    "--member-function",      "--function",
+    "--function-template",    "-F",
+    "--class",                "--class-template",
+    "--class-constructor",    "--class-destructor",
+    "-C",                     "--for-statement",
+    "--namespace-alias",      "--parameter-declaration",
+    "--typedef",              "--using-declaration",
+    "--variable-declaration", "--include-expressions",
+    "--static-cast",          "--dynamic-cast",
+    "--reinterpret-cast",     "--const-cast",
+    "-c",                     "--throw-expression",
+};
+
+// The first query flag set on the command line, or nullptr
+const char* used_query_flag(const argparse::ArgumentParser& program)
+{
+  for (const auto* flag : query_flags) {
+    if (program.get<bool>(flag)) {
+      return flag;
+    }
+  }
+  return nullptr;
+}
+
+// Compiles a --regex query. Throws std::runtime_error if it is invalid.
+std::shared_ptr<const search::regex> compile_regex(std::string_view pattern,
+                                                   bool ignore_case)
+{
+  auto compiled = std::make_shared<search::regex>();
+  std::string error;
+  if (!compiled->compile(pattern, error, ignore_case)) {
+    throw std::runtime_error(
+        fmt::format("Invalid regular expression '{}': {}", pattern, error));
+  }
+  return compiled;
+}
+
+// The query described by the flags of add_query_arguments. Throws
+// std::runtime_error if it is invalid.
+search::query make_query(const argparse::ArgumentParser& program,
+                         std::string text,
+                         std::size_t id)
+{
+  auto search_for_enum = program.get<bool>("--enum");
+  auto search_for_struct = program.get<bool>("--struct");
+  auto search_for_union = program.get<bool>("--union");
+  auto search_for_member_function = program.get<bool>("--member-function");
+  auto search_for_function = program.get<bool>("--function");
+  auto search_for_function_template = program.get<bool>("--function-template");
+  auto search_for_any_function = program.get<bool>("-F");
+  auto search_for_class = program.get<bool>("--class");
+  auto search_for_class_template = program.get<bool>("--class-template");
+  auto search_for_class_constructor = program.get<bool>("--class-constructor");
+  auto search_for_class_destructor = program.get<bool>("--class-destructor");
+  auto search_for_any_class_or_struct = program.get<bool>("-C");
+  auto search_for_typedef = program.get<bool>("--typedef");
+  auto search_for_using_declaration = program.get<bool>("--using-declaration");
+  auto search_for_namespace_alias = program.get<bool>("--namespace-alias");
+  auto search_expressions = program.get<bool>("--include-expressions");
+  auto search_for_variable_declaration =
+      program.get<bool>("--variable-declaration");
+  auto search_for_parameter_declaration =
+      program.get<bool>("--parameter-declaration");
+
+  auto search_for_static_cast = program.get<bool>("--static-cast");
+  auto search_for_dynamic_cast = program.get<bool>("--dynamic-cast");
+  auto search_for_reinterpret_cast = program.get<bool>("--reinterpret-cast");
+  auto search_for_const_cast = program.get<bool>("--const-cast");
+  auto search_for_any_cast = program.get<bool>("-c");
+
+  auto search_for_throw_expression = program.get<bool>("--throw-expression");
+
+  auto search_for_for_statement = program.get<bool>("--for-statement");
+
+  auto no_filter =
+      !(search_for_enum || search_for_struct || search_for_union
+        || search_for_member_function || search_for_function
+        || search_for_function_template || search_for_any_function
+        || search_for_class || search_for_class_template
+        || search_for_class_constructor || search_for_class_destructor
+        || search_for_any_class_or_struct || search_for_typedef
+        || search_for_using_declaration || search_for_namespace_alias
+        || search_for_variable_declaration || search_for_parameter_declaration
+        || search_for_static_cast || search_for_dynamic_cast
+        || search_for_reinterpret_cast || search_for_const_cast
+        || search_for_any_cast || search_for_throw_expression
+        || search_for_for_statement);
+
+  search::query query;
+  query.id = id;
+  query.text = std::move(text);
+  query.exact_match = program.get<bool>("--exact-match");
+  query.ignore_case = program.get<bool>("--ignore-case");
+  if (program.get<bool>("--regex")) {
+    query.pattern = compile_regex(query.text, query.ignore_case);
+    if (query.exact_match) {
+      query.exact_pattern =
+          compile_regex("^(" + query.text + ")$", query.ignore_case);
+    }
+  }
+  query.search_for_enum = no_filter || search_for_enum;
+  query.search_for_struct =
+      no_filter || search_for_any_class_or_struct || search_for_struct;
+  query.search_for_union = no_filter || search_for_union;
+  query.search_for_member_function =
+      no_filter || search_for_any_function || search_for_member_function;
+  query.search_for_function =
+      no_filter || search_for_any_function || search_for_function;
+  query.search_for_function_template =
+      no_filter || search_for_any_function || search_for_function_template;
+  query.search_for_class =
+      no_filter || search_for_any_class_or_struct || search_for_class;
+  query.search_for_class_template =
+      no_filter || search_for_any_class_or_struct || search_for_class_template;
+  query.search_for_class_constructor =
+      no_filter || search_for_class_constructor;
+  query.search_for_class_destructor = no_filter || search_for_class_destructor;
+  query.search_for_typedef = no_filter || search_for_typedef;
+  query.search_for_using_declaration =
+      no_filter || search_for_using_declaration;
+  query.search_for_namespace_alias = no_filter || search_for_namespace_alias;
+  query.search_for_variable_declaration =
+      no_filter || search_for_variable_declaration;
+  query.search_for_parameter_declaration =
+      no_filter || search_for_parameter_declaration;
+  query.search_expressions = search_expressions;
+  query.search_for_static_cast =
+      no_filter || search_for_any_cast || search_for_static_cast;
+  query.search_for_dynamic_cast =
+      no_filter || search_for_any_cast || search_for_dynamic_cast;
+  query.search_for_reinterpret_cast =
+      no_filter || search_for_any_cast || search_for_reinterpret_cast;
+  query.search_for_const_cast =
+      no_filter || search_for_any_cast || search_for_const_cast;
+  query.search_for_throw_expression = no_filter || search_for_throw_expression;
+  query.search_for_for_statement = no_filter || search_for_for_statement;
+  return query;
+}
+
+// Reads a --queries-from file: one query per line, after any of the
+// flags of add_query_arguments. Empty lines and lines starting with '#'
+// are skipped.
+std::vector<search::query> read_queries(const std::string& path)
+{
+  std::ifstream file(path);
+  if (!file) {
+    fmt::print(fmt::fg(fmt::color::red) | fmt::emphasis::bold,
+               "\nError: Unable to open '{}'\n",
+               path);
+    std::exit(1);
+  }
+
+  std::vector<search::query> queries;
+  std::string line;
+  for (std::size_t line_number = 1; std::getline(file, line); ++line_number)
+  {
+    std::vector<std::string> arguments {"fccf"};
+    std::istringstream words(line);
+    for (std::string word; words >> word;) {
+      arguments.push_back(std::move(word));
+    }
+    if (arguments.size() == 1 || arguments[1].front() == '#') {
+      continue;
+    }
+
+    argparse::ArgumentParser parser("fccf");
+    add_query_arguments(parser);
+    parser.add_argument("query").remaining();
+    try {
+      parser.parse_args(arguments);
+      // A query with spaces, e.g., `unsigned int`, spans several words
+      std::string text;
+      for (const auto& word : parser.get<std::vector<std::string>>("query"))
+      {
+        text += (text.empty() ? "" : " ") + word;
+      }
+      queries.push_back(
+          make_query(parser, std::move(text), queries.size() + 1));
+    } catch (const std::exception& err) {
+      fmt::print(fmt::fg(fmt::color::red) | fmt::emphasis::bold,
+                 "\nError: {}:{}: {}\n",
+                 path,
+                 line_number,
+                 err.what());
+      std::exit(1);
+    }
+  }
+
+  if (queries.empty()) {
+    fmt::print(fmt::fg(fmt::color::red) | fmt::emphasis::bold,
+               "\nError: No queries in '{}'\n",
+               path);
+    std::exit(1);
+  }
+  return queries;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  auto is_stdout = isatty(STDOUT_FILENO) == 1;
+  std::ios_base::sync_with_stdio(false);
+  std::cin.tie(NULL);
+  argparse::ArgumentParser program("fccf", "0.6.0");
+  // The query, then the paths; with --queries-from, only paths. They are
+  // split after parsing, since the query is only there without it.
+  program.add_argument("query")
+      .help(
+          "The query, followed by the paths to search (default: the current "
+          "directory). With --queries-from, only the paths")
+      .remaining();
+
+  // Generic Program Information
+  program.add_argument("-h", "--help")
+      .help("Shows help message and exits")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--json")
+      .help("Print results in JSON format")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--jsonl")
+      .help(
+          "Print each result as a JSON object on its own line as soon as it "
+          "is found")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--unordered")
+      .help(
+          "Print each file's results as soon as it is searched, instead of "
+          "all results in path order at the end")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--max-results")
+      .help("Stop searching after this many results (default: no limit)")
+      .scan<'d', int>()
+      .default_value(0);
+
+  // -l is already --language
+  program.add_argument("--files-with-matches")
+      .help(
+          "Only print the names of the files with results, one per line, "
+          "and stop parsing each one at its first result")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--count")
+      .help(
+          "Only print the number of results in each file, as path:count, "
+          "instead of the results")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--count-by-kind")
+      .help(
+          "Only print the number of results of each cursor kind, as "
+          "kind:count, instead of the results")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("-f", "--filter")
+      .help("Only evaluate files that match filter pattern")
+      .default_value(std::string {"*.*"});
+
+  program.add_argument("--no-ignore-dirs")
+      .help(
+          "Do not ignore files under an integrated list of blocklisted "
+          "directories (VCS, IDE, common build directories, etc.) or "
+          "matched by .gitignore/.ignore files")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--ignore-dir")
+      .default_value<std::vector<std::string>>({})
+      .append()
+      .help(
+          "Additional directory name to skip, on top of the integrated "
+          "list of blocklisted directories");
+
+  program.add_argument("--no-io-uring")
+      .help(
+          "Read files one at a time with blocking reads instead of in "
+          "batches through io_uring")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("-j")
+      .help("Number of threads")
+      .scan<'d', int>()
+      .default_value(5);
+
+  program.add_argument("--scan-jobs")
+      .help(
+          "Number of threads that walk directories, read files and look "
+          "for the query in them (default: -j)")
+      .scan<'d', int>()
+      .default_value(0);
+
+  program.add_argument("--parse-jobs")
+      .help(
+          "Number of files parsed with libclang at the same time "
+          "(default: -j)")
+      .scan<'d', int>()
+      .default_value(0);
+
+  add_query_arguments(program);
+
+  program.add_argument("--queries-from")
+      .help(
+          "Search for every query listed in the given file, one per line, "
+          "in a single pass over the files. Each query may be preceded by "
+          "its own kind flags (e.g., `--class -E lexer`), which cannot be "
+          "given on the command line. All positional arguments are then "
+          "paths")
+      .default_value(std::string {});
+
+  program.add_argument("--stats")
+      .help(
+          "Print the time spent in each phase of the search and counts of "
+          "files, parses and results to stderr")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--trace")
+      .help(
+          "Write a timeline of the search to the given path, in the Chrome "
+          "trace-event format (open it in Perfetto or chrome://tracing)")
+      .default_value(std::string {});
+
+  program.add_argument("--verbose")
+      .help("Request verbose output")
+      .default_value(false)
+      .implicit_value(true);
 
   program.add_argument("--isl", "--ignore-single-line-results")
       .help("Ignore forward declarations, member function declarations, etc.")
       .default_value(false)
       .implicit_value(true);
 
+  program.add_argument("--visit-headers")
+      .help(
+          "Also visit the declarations pulled in from headers included by "
+          "each file, instead of only the file itself")
+      .default_value(false)
+      .implicit_value(true);
+
   program.add_argument("-I", "--include-dir")
       .default_value<std::vector<std::string>>({})
       .append()
       .help("Additional include directories");
 
+  program.add_argument("--index")
+      .help(
+          "Keep the declarations found in each file in an index at the given "
+          "path, and answer later searches from it. Only files that changed "
+          "since they were indexed are parsed again")
+      .default_value(std::string {});
+
+  program.add_argument("-p")
+      .help(
+          "Build directory containing a compile_commands.json. Files listed "
+          "there are parsed with their exact compile flags")
+      .default_value(std::string {});
+
   program.add_argument("-l", "--language")
       .default_value<std::string>(std::string {"c++"})
       .help("Language option used by clang");
@@ -229,80 +577,88 @@ int main(int argc, char* argv[])
     }
   }
 
+  if (program.get<bool>("--help")) {
+    std::cout << program << std::endl;
+    return 0;
+  }
+
   std::vector<std::string> paths;
   try {
-    paths = program.get<std::vector<std::string>>("path");
+    paths = program.get<std::vector<std::string>>("query");
   } catch (const std::logic_error& e) {
-    // No path provided
+    // No positional arguments
+  }
+  std::string query;
+  auto queries_from = program.get<std::string>("--queries-from");
+  if (queries_from.empty()) {
+    if (paths.empty()) {
+      std::cerr << "query: 1 argument(s) expected." << std::endl;
+      std::cerr << program;
+      std::exit(1);
+    }
+    query = std::move(paths.front());
+    paths.erase(paths.begin());
+  } else if (const auto* flag = used_query_flag(program)) {
+    // The flags of each query are on its line of the file
+    fmt::print(fmt::fg(fmt::color::red) | fmt::emphasis::bold,
+               "\nError: {} cannot be combined with --queries-from; put it "
+               "in front of the queries in '{}' instead\n",
+               flag,
+               queries_from);
+    std::exit(1);
+  }
+  if (paths.empty()) {
     paths = {"."};
   }
-  auto query = program.get<std::string>("query");
-  auto exact_match = program.get<bool>("--exact-match");
 
   auto filter = program.get<std::string>("-f");
   auto no_ignore_dirs = program.get<bool>("--no-ignore-dirs");
+  auto ignore_dirs = program.get<std::vector<std::string>>("--ignore-dir");
 
-  auto num_threads = program.get<int>("-j");
-
-  auto search_for_enum = program.get<bool>("--enum");
-  auto search_for_struct = program.get<bool>("--struct");
-  auto search_for_union = program.get<bool>("--union");
-  auto search_for_member_function = program.get<bool>("--member-function");
-  auto search_for_function = program.get<bool>("--function");
-  auto search_for_function_template = program.get<bool>("--function-template");
-  auto search_for_any_function = program.get<bool>("-F");
-  auto search_for_class = program.get<bool>("--class");
-  auto search_for_class_template = program.get<bool>("--class-template");
-  auto search_for_class_constructor = program.get<bool>("--class-constructor");
-  auto search_for_class_destructor = program.get<bool>("--class-destructor");
-  auto search_for_any_class_or_struct = program.get<bool>("-C");
-  auto search_for_typedef = program.get<bool>("--typedef");
-  auto search_for_using_declaration = program.get<bool>("--using-declaration");
-  auto search_for_namespace_alias = program.get<bool>("--namespace-alias");
-  auto search_expressions = program.get<bool>("--include-expressions");
-  auto search_for_variable_declaration =
-      program.get<bool>("--variable-declaration");
-  auto search_for_parameter_declaration =
-      program.get<bool>("--parameter-declaration");
+  auto no_io_uring = program.get<bool>("--no-io-uring");
 
-  auto search_for_static_cast = program.get<bool>("--static-cast");
-  auto search_for_dynamic_cast = program.get<bool>("--dynamic-cast");
-  auto search_for_reinterpret_cast = program.get<bool>("--reinterpret-cast");
-  auto search_for_const_cast = program.get<bool>("--const-cast");
-  auto search_for_any_cast = program.get<bool>("-c");
-
-  auto search_for_throw_expression = program.get<bool>("--throw-expression");
-
-  auto search_for_for_statement = program.get<bool>("--for-statement");
+  auto num_threads = program.get<int>("-j");
+  auto scan_jobs = program.get<int>("--scan-jobs");
+  auto parse_jobs = program.get<int>("--parse-jobs");
+  if (scan_jobs <= 0) {
+    scan_jobs = num_threads;
+  }
+  if (parse_jobs <= 0) {
+    parse_jobs = num_threads;
+  }
 
   auto verbose = program.get<bool>("--verbose");
+  auto print_stats = program.get<bool>("--stats");
+  auto trace_path = program.get<std::string>("--trace");
   auto include_dirs = program.get<std::vector<std::string>>("--include-dir");
   auto language_option = program.get<std::string>("--language");
   auto cpp_std = program.get<std::string>("--std");
+  auto build_dir = program.get<std::string>("-p");
+  auto index_path = program.get<std::string>("--index");
   auto ignore_single_line_results =
       program.get<bool>("--ignore-single-line-results");
 
+  auto visit_headers = program.get<bool>("--visit-headers");
+
   auto no_color = program.get<bool>("--no-color");
   auto is_json = program.get<bool>("--json");
+  auto is_json_lines = program.get<bool>("--jsonl");
+  auto unordered = program.get<bool>("--unordered");
+  auto max_results = program.get<int>("--max-results");
+  auto files_with_matches = program.get<bool>("--files-with-matches");
+  auto count = program.get<bool>("--count");
+  auto count_by_kind = program.get<bool>("--count-by-kind");
+  auto count_only = count || count_by_kind;
+  if (files_with_matches || count_only) {
+    // Only file names or counts are printed, whatever the output format
+    is_json = false;
+    is_json_lines = false;
+  }
 
   if (no_color) {
     is_stdout = false;
   }
 
-  auto no_filter =
-      !(search_for_enum || search_for_struct || search_for_union
-        || search_for_member_function || search_for_function
-        || search_for_function_template || search_for_any_function
-        || search_for_class || search_for_class_template
-        || search_for_class_constructor || search_for_class_destructor
-        || search_for_any_class_or_struct || search_for_typedef
-        || search_for_using_declaration || search_for_namespace_alias
-        || search_for_variable_declaration || search_for_parameter_declaration
-        || search_for_static_cast || search_for_dynamic_cast
-        || search_for_reinterpret_cast || search_for_const_cast
-        || search_for_any_cast || search_for_throw_expression
-        || search_for_for_statement);
-
   auto ends_with = [](std::string_view str, std::string_view suffix) -> bool
   {
     return str.size() >= suffix.size()
@@ -317,110 +673,188 @@ int main(int argc, char* argv[])
 
   // Configure a searcher
   search::searcher searcher;
-  searcher.m_query = query;
   searcher.m_filter = filter;
   searcher.m_no_ignore_dirs = no_ignore_dirs;
+  for (const auto& ignore_dir : ignore_dirs) {
+    // Accept `build/` as well as `build`
+    std::string_view name = ignore_dir;
+    while (name.size() > 1 && name.back() == '/') {
+      name.remove_suffix(1);
+    }
+    searcher.m_ignored_dirs.insert(name);
+  }
+  searcher.m_use_io_uring = !no_io_uring;
   searcher.m_is_stdout = is_stdout;
   searcher.m_verbose = verbose;
-  searcher.m_exact_match = exact_match;
-  searcher.m_search_for_enum = no_filter || search_for_enum;
-  searcher.m_search_for_struct =
-      no_filter || search_for_any_class_or_struct || search_for_struct;
-  searcher.m_search_for_union = no_filter || search_for_union;
-  searcher.m_search_for_member_function =
-      no_filter || search_for_any_function || search_for_member_function;
-  searcher.m_search_for_function =
-      no_filter || search_for_any_function || search_for_function;
-  searcher.m_search_for_function_template =
-      no_filter || search_for_any_function || search_for_function_template;
-  searcher.m_search_for_class =
-      no_filter || search_for_any_class_or_struct || search_for_class;
-  searcher.m_search_for_class_template =
-      no_filter || search_for_any_class_or_struct || search_for_class_template;
-  searcher.m_search_for_class_constructor =
-      no_filter || search_for_class_constructor;
-  searcher.m_search_for_class_destructor =
-      no_filter || search_for_class_destructor;
-  searcher.m_search_for_typedef = no_filter || search_for_typedef;
-  searcher.m_search_for_using_declaration =
-      no_filter || search_for_using_declaration;
-  searcher.m_search_for_namespace_alias =
-      no_filter || search_for_namespace_alias;
-  searcher.m_search_for_variable_declaration =
-      no_filter || search_for_variable_declaration;
-  searcher.m_search_for_parameter_declaration =
-      no_filter || search_for_parameter_declaration;
-  searcher.m_search_expressions = search_expressions;
-  searcher.m_search_for_static_cast =
-      no_filter || search_for_any_cast || search_for_static_cast;
-  searcher.m_search_for_dynamic_cast =
-      no_filter || search_for_any_cast || search_for_dynamic_cast;
-  searcher.m_search_for_reinterpret_cast =
-      no_filter || search_for_any_cast || search_for_reinterpret_cast;
-  searcher.m_search_for_const_cast =
-      no_filter || search_for_any_cast || search_for_const_cast;
-
-  searcher.m_search_for_throw_expression =
-      no_filter || search_for_throw_expression;
-
-  searcher.m_search_for_for_statement = no_filter || search_for_for_statement;
+  search::stats::m_enabled = print_stats;
+  if (!trace_path.empty()) {
+    search::trace::start();
+  }
+  if (queries_from.empty()) {
+    try {
+      searcher.m_queries.push_back(make_query(program, query, 0));
+    } catch (const std::runtime_error& err) {
+      fmt::print(fmt::fg(fmt::color::red) | fmt::emphasis::bold,
+                 "\nError: {}\n",
+                 err.what());
+      std::exit(1);
+    }
+  } else {
+    searcher.m_queries = read_queries(queries_from);
+  }
   searcher.m_ignore_single_line_results = ignore_single_line_results;
-  searcher.m_ts = std::make_unique<thread_pool>(num_threads);
+  searcher.m_main_file_only = !visit_headers;
+  searcher.m_ts = std::make_unique<search::work_stealing_pool>(scan_jobs);
+  searcher.m_parse_pool =
+      std::make_unique<search::work_stealing_pool>(parse_jobs);
+  // Enough files ready to keep every parser busy while the next ones are
+  // found
+  searcher.m_parse_queue_size = 2 * static_cast<std::size_t>(parse_jobs);
+
+  if (!build_dir.empty()) {
+    if (!searcher.m_compilation_database.load(build_dir.c_str())) {
+      fmt::print(fmt::fg(fmt::color::red) | fmt::emphasis::bold,
+                 "\nError: Unable to load compile_commands.json from '{}'\n",
+                 build_dir);
+      std::exit(1);
+    }
+    if (verbose) {
+      fmt::print("Loaded compile commands for {} files from {}\n",
+                 searcher.m_compilation_database.size(),
+                 build_dir);
+    }
+  }
+
+  if (verbose) {
+#if defined(__SSE2__)
+    fmt::print("Substring search kernel: {}\n",
+               search::simd_strstr_kernel_name());
+#else
+    fmt::print("Substring search kernel: std::search\n");
+#endif
+    fmt::print("File reads: {}\n",
+               searcher.m_use_io_uring && search::io_uring_available()
+                   ? "io_uring"
+                   : "blocking");
+    fmt::print("Scan jobs: {}, parse jobs: {}\n", scan_jobs, parse_jobs);
+  }
 
-  nlohmann::json json_array = nlohmann::json::array();
+  searcher.m_max_results = static_cast<std::size_t>(std::max(max_results, 0));
+  searcher.m_files_with_matches = files_with_matches;
+  searcher.m_count_only = count_only;
+  searcher.m_results.set_ordered(!unordered);
   if (is_json) {
-    searcher.m_custom_printer = [&json_array](std::string_view filename,
-                                             bool is_stdout,
-                                             unsigned start_line,
-                                             unsigned end_line,
-                                             std::string_view code_snippet)
+    searcher.m_results.set_framing("[", ",", "]");
+    searcher.m_custom_printer = [](fmt::memory_buffer& out,
+                                   std::string_view filename,
+                                   bool /*is_stdout*/,
+                                   unsigned start_line,
+                                   unsigned end_line,
+                                   std::string_view code_snippet,
+                                   std::size_t query_id)
     {
       nlohmann::json obj;
       obj["filename"] = filename;
       obj["snippet"] = code_snippet;
       obj["start_line"] = start_line;
       obj["end_line"] = end_line;
-      json_array.push_back(obj);
+      if (query_id != 0) {
+        obj["query_id"] = query_id;
+      }
+      const auto dump = obj.dump();
+      out.append(dump.data(), dump.data() + dump.size());
+    };
+  } else if (is_json_lines) {
+    searcher.m_results.set_streaming(true);
+    searcher.m_custom_printer = [](fmt::memory_buffer& out,
+                                   std::string_view filename,
+                                   bool /*is_stdout*/,
+                                   unsigned start_line,
+                                   unsigned end_line,
+                                   std::string_view code_snippet,
+                                   std::size_t query_id)
+    {
+      search::append_json_line(
+          out, filename, start_line, end_line, code_snippet, query_id);
     };
   }
 
+  const auto start_time = search::stats::clock::now();
+
+  // The clang options each path is searched with. The include directories
+  // found under a path are kept for the paths after it.
+  std::vector<std::vector<std::string>> path_clang_options;
   for (const auto& path : paths) {
-    // Update clang options
     auto parent_path = path == "." ? "." : fs::path(path).parent_path();
     auto parent_path_string = parent_path.c_str();
 
-    // Iterate over the `std::filesystem::directory_entry` elements using `auto`
-    for (auto const& dir_entry : fs::recursive_directory_iterator(parent_path))
+    // Ignored directories are pruned like in the search itself, so that
+    // build trees, node_modules, etc. are never walked here either
+    for (auto it = fs::recursive_directory_iterator(parent_path);
+         it != fs::recursive_directory_iterator();
+         ++it)
     {
-      auto& path = dir_entry.path();
+      auto& path = it->path();
       if (fs::is_directory(path)) {
-        // If directory name is include
         std::string_view directory_name = path.filename().c_str();
+        if (!no_ignore_dirs
+            && search::searcher::is_ignored_directory(directory_name))
+        {
+          it.disable_recursion_pending();
+          continue;
+        }
+        // If directory name is include
         if (ends_with(directory_name, "include")) {
           include_directory_list.push_back("-I" + std::string {path});
         }
       }
     }
 
-    std::vector<const char*> clang_options;
-    clang_options.push_back("-x");
-    clang_options.push_back(language_option.c_str());
-
-    auto language_standard = "-std=" + cpp_std;
+    auto& options = path_clang_options.emplace_back();
+    options = {"-x", language_option};
     if (language_option == "c++") {
-      clang_options.push_back(language_standard.c_str());
+      options.push_back("-std=" + cpp_std);
     }
+    options.insert(options.end(),
+                   include_directory_list.begin(),
+                   include_directory_list.end());
+  }
 
-    for (auto& include_directory : include_directory_list) {
-      clang_options.push_back(include_directory.c_str());
+  if (!index_path.empty()) {
+    // The index is only valid for the options its files were parsed with
+    std::vector<std::string> parse_options {build_dir,
+                                            visit_headers ? "1" : "0"};
+    // Editing the compilation database changes the options of the files
+    // it lists, whatever their own stamps say
+    search::file_stamp database_stamp {};
+    if (!build_dir.empty()) {
+      search::get_file_stamp(
+          (fs::path(build_dir) / "compile_commands.json").c_str(),
+          database_stamp);
     }
+    parse_options.push_back(std::to_string(database_stamp.mtime_ns));
+    parse_options.push_back(std::to_string(database_stamp.size));
+    for (const auto& options : path_clang_options) {
+      parse_options.insert(parse_options.end(), options.begin(), options.end());
+    }
+    searcher.m_index.open(index_path,
+                          search::options_fingerprint(parse_options));
+  }
 
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    const auto& path = paths[i];
+    std::vector<const char*> clang_options;
+    for (const auto& option : path_clang_options[i]) {
+      clang_options.push_back(option.c_str());
+    }
     searcher.m_clang_options = clang_options;
 
     // Run the search
 
     if (fs::is_regular_file(fs::path(path))) {
+      search::stats::add(search::counter::files_seen);
       searcher.read_file_and_search((const char*)path.c_str());
+      searcher.wait_for_tasks();
     } else if (fs::is_directory(fs::path(path))) {
       searcher.directory_search((const char*)path.c_str());
     } else {
@@ -429,11 +863,33 @@ int main(int argc, char* argv[])
                  path);
       std::exit(1);
     }
+    searcher.m_results.flush();
+    if (searcher.m_cancelled) {
+      break;
+    }
+  }
+  searcher.m_results.finish();
+  if (count_only) {
+    searcher.m_counts.print(count, count_by_kind);
   }
 
-  if (is_json) {
-    fmt::print("{}", json_array.dump());
+  if (!searcher.m_index.save()) {
+    fmt::print(fmt::fg(fmt::color::red) | fmt::emphasis::bold,
+               "\nError: Unable to write index '{}'\n",
+               index_path);
+  }
+
+  if (!is_json_lines && !files_with_matches && !count_only) {
+    fmt::print("\n");
+  }
+
+  if (print_stats) {
+    search::stats::print(search::stats::clock::now() - start_time);
+  }
+  if (!trace_path.empty() && !search::trace::write(trace_path)) {
+    fmt::print(fmt::fg(fmt::color::red) | fmt::emphasis::bold,
+               "\nError: Unable to write trace '{}'\n",
+               trace_path);
   }
-  fmt::print("\n");
   return 0;
 }
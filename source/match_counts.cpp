@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cstdio>
+
+#include <clang-c/Index.h>
+#include <fmt/core.h>
+#include <match_counts.hpp>
+
+namespace search
+{
+match_counts::tally& match_counts::local()
+{
+  struct cache
+  {
+    const match_counts* owner {nullptr};
+    tally* counters {nullptr};
+  };
+  thread_local cache this_thread;
+
+  if (this_thread.owner != this) {
+    const std::scoped_lock lock(m_mutex);
+    m_tallies.push_back(std::make_unique<tally>());
+    this_thread = {this, m_tallies.back().get()};
+  }
+  return *this_thread.counters;
+}
+
+void match_counts::add_file(std::string_view path, std::size_t count)
+{
+  local().files.emplace_back(path, count);
+}
+
+void match_counts::add_kind(unsigned kind)
+{
+  ++local().kinds[kind];
+}
+
+void match_counts::print(bool by_file, bool by_kind) const
+{
+  const std::scoped_lock lock(m_mutex);
+
+  if (by_file) {
+    std::vector<std::pair<std::string, std::size_t>> files;
+    for (const auto& counters : m_tallies) {
+      files.insert(files.end(), counters->files.begin(), counters->files.end());
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto& [path, count] : files) {
+      fmt::print("{}:{}\n", path, count);
+    }
+  }
+
+  if (by_kind) {
+    std::unordered_map<unsigned, std::size_t> merged;
+    for (const auto& counters : m_tallies) {
+      for (const auto& [kind, count] : counters->kinds) {
+        merged[kind] += count;
+      }
+    }
+    std::vector<std::pair<unsigned, std::size_t>> kinds(merged.begin(),
+                                                        merged.end());
+    std::sort(kinds.begin(),
+              kinds.end(),
+              [](const auto& a, const auto& b)
+              {
+                return a.second != b.second ? a.second > b.second
+                                            : a.first < b.first;
+              });
+    for (const auto& [kind, count] : kinds) {
+      CXString spelling =
+          clang_getCursorKindSpelling(static_cast<CXCursorKind>(kind));
+      fmt::print("{}:{}\n", clang_getCString(spelling), count);
+      clang_disposeString(spelling);
+    }
+  }
+  std::fflush(stdout);
+}
+
+}  // namespace search
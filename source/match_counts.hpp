@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace search
+{
+// The result counts printed by --count and --count-by-kind. Every thread
+// tallies into counters of its own; they are only merged, once, when the
+// counts are printed.
+class match_counts
+{
+public:
+  // Thread-safe
+  void add_file(std::string_view path, std::size_t count);
+  void add_kind(unsigned kind);
+
+  // Writes the per-file counts, in path order, and/or the per-kind
+  // counts, most frequent first, to stdout. Only call once every search
+  // task has finished.
+  void print(bool by_file, bool by_kind) const;
+
+private:
+  struct tally
+  {
+    std::vector<std::pair<std::string, std::size_t>> files;
+    std::unordered_map<unsigned, std::size_t> kinds;
+  };
+
+  tally& local();
+
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<tally>> m_tallies;
+};
+
+}  // namespace search
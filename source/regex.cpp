@@ -0,0 +1,826 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include <regex.hpp>
+
+namespace search
+{
+struct regex_node
+{
+  enum kind_type
+  {
+    // Matches the empty string
+    empty,
+    // Matches one byte in `bytes`
+    bytes,
+    begin,
+    end,
+    concatenation,
+    alternation,
+    // `children[0]` between min and max times, max < 0 for no limit
+    repetition,
+  };
+
+  kind_type kind {empty};
+  std::bitset<256> byte_set;
+  std::vector<regex_node> children;
+  int min {0};
+  int max {0};
+};
+
+namespace
+{
+// Repetition counts and nesting are bounded, so a pattern cannot blow up
+// the NFA or the stack
+constexpr int max_repetition = 1000;
+constexpr int max_depth = 256;
+constexpr std::size_t max_nfa_states = 100000;
+
+// Above this many states, a thread's DFA is thrown away and rebuilt
+constexpr std::size_t max_dfa_states = 4096;
+
+using byte_set = std::bitset<256>;
+
+byte_set byte_range(unsigned char first, unsigned char last)
+{
+  byte_set set;
+  for (unsigned c = first; c <= last; ++c) {
+    set.set(c);
+  }
+  return set;
+}
+
+// The byte of a set with a single one
+char only_byte(const byte_set& set)
+{
+  unsigned c = 0;
+  while (!set[c]) {
+    ++c;
+  }
+  return static_cast<char>(c);
+}
+
+// Adds the other case of every ASCII letter in the set
+byte_set fold_case(byte_set set)
+{
+  for (unsigned c = 'a'; c <= 'z'; ++c) {
+    if (set[c] || set[c - ('a' - 'A')]) {
+      set.set(c);
+      set.set(c - ('a' - 'A'));
+    }
+  }
+  return set;
+}
+
+byte_set digits()
+{
+  return byte_range('0', '9');
+}
+
+byte_set word_bytes()
+{
+  return byte_range('a', 'z') | byte_range('A', 'Z') | digits()
+      | byte_range('_', '_');
+}
+
+byte_set space_bytes()
+{
+  byte_set set;
+  for (const char c : {' ', '\t', '\n', '\r', '\f', '\v'}) {
+    set.set(static_cast<unsigned char>(c));
+  }
+  return set;
+}
+
+// Recursive descent over
+//   alternation   := concatenation ('|' concatenation)*
+//   concatenation := repetition*
+//   repetition    := atom ('*' | '+' | '?' | '{' n [',' [m]] '}')*
+//   atom          := '(' alternation ')' | '[' class ']' | '.' | '^' | '$'
+//                  | '\' escape | byte
+class parser
+{
+public:
+  // With `ignore_case`, negated classes leave out both cases of their
+  // letters. The other sets are folded as they are compiled, so that the
+  // literals of the tree keep the case they were written in.
+  parser(std::string_view pattern, bool ignore_case)
+      : m_pattern(pattern)
+      , m_ignore_case(ignore_case)
+  {
+  }
+
+  regex_node parse()
+  {
+    auto n = alternation();
+    if (m_pos != m_pattern.size()) {
+      fail("unmatched ')'");
+    }
+    return n;
+  }
+
+private:
+  [[noreturn]] void fail(const std::string& message) const
+  {
+    throw std::runtime_error(message + " at position "
+                             + std::to_string(m_pos));
+  }
+
+  bool at_end() const { return m_pos == m_pattern.size(); }
+
+  char peek() const { return m_pattern[m_pos]; }
+
+  regex_node alternation()
+  {
+    if (++m_depth > max_depth) {
+      fail("pattern nested too deeply");
+    }
+    regex_node n;
+    n.kind = regex_node::alternation;
+    n.children.push_back(concatenation());
+    while (!at_end() && peek() == '|') {
+      ++m_pos;
+      n.children.push_back(concatenation());
+    }
+    --m_depth;
+    if (n.children.size() == 1) {
+      return std::move(n.children.front());
+    }
+    return n;
+  }
+
+  regex_node concatenation()
+  {
+    regex_node n;
+    n.kind = regex_node::concatenation;
+    while (!at_end() && peek() != '|' && peek() != ')') {
+      n.children.push_back(repetition());
+    }
+    if (n.children.size() == 1) {
+      return std::move(n.children.front());
+    }
+    return n;
+  }
+
+  int number()
+  {
+    if (at_end() || peek() < '0' || peek() > '9') {
+      fail("expected a number");
+    }
+    int value = 0;
+    while (!at_end() && peek() >= '0' && peek() <= '9') {
+      value = value * 10 + (peek() - '0');
+      if (value > max_repetition) {
+        fail("repetition count above " + std::to_string(max_repetition));
+      }
+      ++m_pos;
+    }
+    return value;
+  }
+
+  regex_node repetition()
+  {
+    auto n = atom();
+    while (!at_end()) {
+      int min = 0;
+      int max = 0;
+      const char c = peek();
+      if (c == '*') {
+        min = 0;
+        max = -1;
+      } else if (c == '+') {
+        min = 1;
+        max = -1;
+      } else if (c == '?') {
+        min = 0;
+        max = 1;
+      } else if (c == '{') {
+        ++m_pos;
+        min = max = number();
+        if (!at_end() && peek() == ',') {
+          ++m_pos;
+          max = !at_end() && peek() == '}' ? -1 : number();
+        }
+        if (at_end() || peek() != '}') {
+          fail("expected '}'");
+        }
+        if (max >= 0 && max < min) {
+          fail("invalid repetition range");
+        }
+      } else {
+        break;
+      }
+      ++m_pos;
+
+      regex_node repeated;
+      repeated.kind = regex_node::repetition;
+      repeated.min = min;
+      repeated.max = max;
+      repeated.children.push_back(std::move(n));
+      n = std::move(repeated);
+    }
+    return n;
+  }
+
+  regex_node bytes(const byte_set& set)
+  {
+    regex_node n;
+    n.kind = regex_node::bytes;
+    n.byte_set = set;
+    return n;
+  }
+
+  // The escape after a backslash, as a set of bytes
+  byte_set escape()
+  {
+    if (at_end()) {
+      fail("trailing backslash");
+    }
+    const char c = m_pattern[m_pos++];
+    switch (c) {
+      case 'd':
+        return digits();
+      case 'D':
+        return ~digits();
+      case 'w':
+        return word_bytes();
+      case 'W':
+        return ~word_bytes();
+      case 's':
+        return space_bytes();
+      case 'S':
+        return ~space_bytes();
+      case 'n':
+        return byte_range('\n', '\n');
+      case 'r':
+        return byte_range('\r', '\r');
+      case 't':
+        return byte_range('\t', '\t');
+      default:
+        break;
+    }
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || (c >= '0' && c <= '9'))
+    {
+      --m_pos;
+      fail(std::string("unknown escape '\\") + c + "'");
+    }
+    return byte_range(static_cast<unsigned char>(c),
+                      static_cast<unsigned char>(c));
+  }
+
+  byte_set character_class()
+  {
+    const bool negated = !at_end() && peek() == '^';
+    if (negated) {
+      ++m_pos;
+    }
+    byte_set set;
+    bool first = true;
+    while (true) {
+      if (at_end()) {
+        fail("missing ']'");
+      }
+      char c = m_pattern[m_pos++];
+      // A leading ']' is a literal
+      if (c == ']' && !first) {
+        break;
+      }
+      first = false;
+      if (c == '\\') {
+        const auto escaped = escape();
+        if (escaped.count() != 1) {
+          set |= escaped;
+          continue;
+        }
+        c = only_byte(escaped);
+      }
+      if (m_pos + 1 < m_pattern.size() && peek() == '-'
+          && m_pattern[m_pos + 1] != ']')
+      {
+        ++m_pos;
+        char last = m_pattern[m_pos++];
+        if (last == '\\') {
+          const auto escaped = escape();
+          if (escaped.count() != 1) {
+            fail("invalid class range");
+          }
+          last = only_byte(escaped);
+        }
+        const auto from = static_cast<unsigned char>(c);
+        const auto to = static_cast<unsigned char>(last);
+        if (to < from) {
+          fail("invalid class range");
+        }
+        set |= byte_range(from, to);
+      } else {
+        set.set(static_cast<unsigned char>(c));
+      }
+    }
+    if (negated && m_ignore_case) {
+      set = fold_case(set);
+    }
+    return negated ? ~set : set;
+  }
+
+  regex_node atom()
+  {
+    const char c = m_pattern[m_pos++];
+    switch (c) {
+      case '(': {
+        auto n = at_end() || peek() == ')' ? regex_node {} : alternation();
+        if (at_end() || peek() != ')') {
+          fail("missing ')'");
+        }
+        ++m_pos;
+        return n;
+      }
+      case '[':
+        return bytes(character_class());
+      case '.':
+        return bytes(~byte_range('\n', '\n'));
+      case '^': {
+        regex_node n;
+        n.kind = regex_node::begin;
+        return n;
+      }
+      case '$': {
+        regex_node n;
+        n.kind = regex_node::end;
+        return n;
+      }
+      case '\\':
+        return bytes(escape());
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+        --m_pos;
+        fail(std::string("nothing to repeat before '") + c + "'");
+      default:
+        return bytes(byte_range(static_cast<unsigned char>(c),
+                                static_cast<unsigned char>(c)));
+    }
+  }
+
+  std::string_view m_pattern;
+  std::size_t m_pos {0};
+  int m_depth {0};
+  bool m_ignore_case {false};
+};
+
+// What the prefilter can know about the texts a node matches. `exact`,
+// if known, is every string the node can match; `required` is a set of
+// literals, one of which every match contains (empty: none).
+struct literal_info
+{
+  bool exact_known {false};
+  std::vector<std::string> exact;
+  std::vector<std::string> required;
+};
+
+// Literal sets are kept small: they all end up in the prefilter
+constexpr std::size_t max_literals = 16;
+
+std::size_t shortest(const std::vector<std::string>& literals)
+{
+  std::size_t length = literals.empty() ? 0 : literals.front().size();
+  for (const auto& literal : literals) {
+    length = std::min(length, literal.size());
+  }
+  return length;
+}
+
+// Longer literals reject more files; of equally long ones, fewer are
+// cheaper to look for
+const std::vector<std::string>& better(const std::vector<std::string>& a,
+                                       const std::vector<std::string>& b)
+{
+  const auto a_length = shortest(a);
+  const auto b_length = shortest(b);
+  if (a_length != b_length) {
+    return a_length > b_length ? a : b;
+  }
+  return a.size() <= b.size() ? a : b;
+}
+
+// The exact strings, usable as required literals if none is empty
+std::vector<std::string> as_required(const literal_info& info)
+{
+  if (info.exact_known && !info.exact.empty() && shortest(info.exact) > 0) {
+    return info.exact;
+  }
+  return info.required;
+}
+
+void sort_unique(std::vector<std::string>& literals)
+{
+  std::sort(literals.begin(), literals.end());
+  literals.erase(std::unique(literals.begin(), literals.end()),
+                 literals.end());
+}
+
+literal_info literals(const regex_node& n)
+{
+  literal_info info;
+  switch (n.kind) {
+    case regex_node::empty:
+    case regex_node::begin:
+    case regex_node::end:
+      info.exact_known = true;
+      info.exact = {""};
+      break;
+
+    case regex_node::bytes:
+      if (n.byte_set.count() <= 4) {
+        info.exact_known = true;
+        for (unsigned c = 0; c < 256; ++c) {
+          if (n.byte_set[c]) {
+            info.exact.emplace_back(1, static_cast<char>(c));
+          }
+        }
+      }
+      break;
+
+    case regex_node::concatenation: {
+      // Runs of children with exact strings are multiplied out, e.g.,
+      // `(Read|Write)Buffer`; the best run or child requirement wins
+      std::vector<std::string> run = {""};
+      std::vector<std::string> best;
+      bool exact = true;
+      for (const auto& child : n.children) {
+        const auto child_info = literals(child);
+        if (child_info.exact_known
+            && run.size() * child_info.exact.size() <= max_literals)
+        {
+          std::vector<std::string> product;
+          for (const auto& prefix : run) {
+            for (const auto& suffix : child_info.exact) {
+              product.push_back(prefix + suffix);
+            }
+          }
+          sort_unique(product);
+          run = std::move(product);
+          continue;
+        }
+        exact = false;
+        if (shortest(run) > 0) {
+          best = better(best, run);
+        }
+        if (child_info.exact_known) {
+          run = child_info.exact;
+        } else {
+          best = better(best, child_info.required);
+          run = {""};
+        }
+      }
+      if (exact) {
+        info.exact_known = true;
+        info.exact = std::move(run);
+      } else {
+        if (shortest(run) > 0) {
+          best = better(best, run);
+        }
+        info.required = std::move(best);
+      }
+      break;
+    }
+
+    case regex_node::alternation: {
+      info.exact_known = true;
+      bool required = true;
+      for (const auto& child : n.children) {
+        const auto child_info = literals(child);
+        info.exact_known = info.exact_known && child_info.exact_known;
+        if (info.exact_known) {
+          info.exact.insert(info.exact.end(),
+                            child_info.exact.begin(),
+                            child_info.exact.end());
+        }
+        const auto child_required = as_required(child_info);
+        required = required && !child_required.empty();
+        if (required) {
+          info.required.insert(info.required.end(),
+                               child_required.begin(),
+                               child_required.end());
+        }
+      }
+      sort_unique(info.exact);
+      sort_unique(info.required);
+      if (info.exact.size() > max_literals) {
+        info.exact_known = false;
+      }
+      if (!info.exact_known) {
+        info.exact.clear();
+      }
+      if (!required || info.required.size() > max_literals) {
+        info.required.clear();
+      }
+      break;
+    }
+
+    case regex_node::repetition: {
+      const auto child_info = literals(n.children.front());
+      if (n.min == 1 && n.max == 1) {
+        info = child_info;
+      } else if (n.min == 0 && n.max == 1 && child_info.exact_known) {
+        info.exact_known = true;
+        info.exact = child_info.exact;
+        info.exact.emplace_back();
+        sort_unique(info.exact);
+      } else if (n.min > 0) {
+        info.required = as_required(child_info);
+      }
+      break;
+    }
+  }
+  return info;
+}
+
+std::atomic<std::size_t> next_regex_id {0};
+
+}  // namespace
+
+std::uint32_t regex::add_state(state s)
+{
+  if (m_states.size() >= max_nfa_states) {
+    throw std::runtime_error("pattern too large");
+  }
+  m_states.push_back(s);
+  return static_cast<std::uint32_t>(m_states.size() - 1);
+}
+
+// Thompson's construction, from the end of the pattern backwards: returns
+// the state that matches `n` and then goes on to `next`
+std::uint32_t regex::compile_node(const regex_node& n, std::uint32_t next)
+{
+  switch (n.kind) {
+    case regex_node::empty:
+      return next;
+
+    case regex_node::bytes:
+      m_sets.push_back(m_ignore_case ? fold_case(n.byte_set) : n.byte_set);
+      return add_state({state::byte_set,
+                        next,
+                        0,
+                        static_cast<std::uint32_t>(m_sets.size() - 1)});
+
+    case regex_node::begin:
+      return add_state({state::begin, next});
+
+    case regex_node::end:
+      return add_state({state::end, next});
+
+    case regex_node::concatenation:
+      for (auto it = n.children.rbegin(); it != n.children.rend(); ++it) {
+        next = compile_node(*it, next);
+      }
+      return next;
+
+    case regex_node::alternation: {
+      auto first = compile_node(n.children.back(), next);
+      for (auto it = std::next(n.children.rbegin()); it != n.children.rend();
+           ++it)
+      {
+        const auto branch = compile_node(*it, next);
+        first = add_state({state::split, branch, first});
+      }
+      return first;
+    }
+
+    case regex_node::repetition: {
+      const auto& child = n.children.front();
+      if (n.max < 0) {
+        // A loop back to a split between the child and what follows
+        const auto loop = add_state({state::split, 0, next});
+        m_states[loop].next = compile_node(child, loop);
+        next = loop;
+      } else {
+        // x{0,2} is (x(x)?)?
+        for (int i = n.min; i < n.max; ++i) {
+          next = add_state({state::split, compile_node(child, next), next});
+        }
+      }
+      // The loop or the optional copies above make x+ into xx*
+      for (int i = 0; i < n.min; ++i) {
+        next = compile_node(child, next);
+      }
+      return next;
+    }
+  }
+  return next;
+}
+
+bool regex::compile(std::string_view pattern,
+                    std::string& error,
+                    bool ignore_case)
+{
+  m_states.clear();
+  m_sets.clear();
+  m_ignore_case = ignore_case;
+  regex_node root;
+  try {
+    root = parser(pattern, ignore_case).parse();
+    const auto match = add_state({state::match});
+    m_start = compile_node(root, match);
+  } catch (const std::runtime_error& e) {
+    error = e.what();
+    return false;
+  }
+
+  // Split the bytes into classes that no byte set tells apart
+  m_class.fill(0);
+  m_class_count = 1;
+  for (const auto& set : m_sets) {
+    std::map<std::pair<std::uint16_t, bool>, std::uint16_t> refined;
+    for (unsigned c = 0; c < 256; ++c) {
+      refined.try_emplace({m_class[c], set[c]},
+                          static_cast<std::uint16_t>(refined.size()));
+    }
+    for (unsigned c = 0; c < 256; ++c) {
+      m_class[c] = refined[{m_class[c], set[c]}];
+    }
+    m_class_count = refined.size();
+  }
+  m_set_classes.assign(m_sets.size(), std::vector<bool>(m_class_count));
+  for (std::size_t i = 0; i < m_sets.size(); ++i) {
+    for (unsigned c = 0; c < 256; ++c) {
+      if (m_sets[i][c]) {
+        m_set_classes[i][m_class[c]] = true;
+      }
+    }
+  }
+
+  m_literals = as_required(literals(root));
+  m_id = next_regex_id.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+// A DFA state is a sorted set of the NFA states that consume input, i.e.,
+// byte sets, end anchors and the match state
+struct regex::dfa
+{
+  std::map<std::vector<std::uint32_t>, std::uint32_t> ids;
+  std::vector<std::vector<std::uint32_t>> states;
+  std::vector<bool> accepting;
+  // transitions[state * (class count + 1) + class], `unknown` until the
+  // text first needs it
+  std::vector<std::uint32_t> transitions;
+  std::uint32_t start {0};
+};
+
+namespace
+{
+constexpr auto unknown = std::numeric_limits<std::uint32_t>::max();
+}  // namespace
+
+// Replaces `states` with the consuming states reachable from them.
+// `begin` anchors are only followed at the beginning of the text, and
+// `end` anchors at its end, where any number of them hold at once.
+void regex::closure(std::vector<std::uint32_t>& states,
+                    bool at_begin,
+                    bool at_end) const
+{
+  std::vector<bool> seen(m_states.size());
+  std::vector<std::uint32_t> stack(states.rbegin(), states.rend());
+  states.clear();
+  while (!stack.empty()) {
+    const auto i = stack.back();
+    stack.pop_back();
+    if (seen[i]) {
+      continue;
+    }
+    seen[i] = true;
+    const auto& s = m_states[i];
+    switch (s.kind) {
+      case state::split:
+        stack.push_back(s.alt);
+        stack.push_back(s.next);
+        break;
+      case state::begin:
+        if (at_begin) {
+          stack.push_back(s.next);
+        }
+        break;
+      case state::end:
+        if (at_end) {
+          stack.push_back(s.next);
+        } else {
+          states.push_back(i);
+        }
+        break;
+      default:
+        states.push_back(i);
+        break;
+    }
+  }
+  std::sort(states.begin(), states.end());
+}
+
+std::uint32_t regex::add_dfa_state(dfa& d,
+                                   std::vector<std::uint32_t> states) const
+{
+  const auto found = d.ids.find(states);
+  if (found != d.ids.end()) {
+    return found->second;
+  }
+  const auto id = static_cast<std::uint32_t>(d.states.size());
+  const bool accepting = std::any_of(
+      states.begin(),
+      states.end(),
+      [this](std::uint32_t i) { return m_states[i].kind == state::match; });
+  d.ids.emplace(states, id);
+  d.states.push_back(std::move(states));
+  d.accepting.push_back(accepting);
+  d.transitions.resize(d.transitions.size() + m_class_count + 1, unknown);
+  return id;
+}
+
+std::uint32_t regex::step(dfa& d,
+                          std::uint32_t from,
+                          std::size_t byte_class) const
+{
+  const auto columns = m_class_count + 1;
+  const auto cached = d.transitions[from * columns + byte_class];
+  if (cached != unknown) {
+    return cached;
+  }
+
+  const bool at_end = byte_class == m_class_count;
+  std::vector<std::uint32_t> next;
+  for (const auto i : d.states[from]) {
+    const auto& s = m_states[i];
+    if (at_end ? s.kind == state::end
+               : s.kind == state::byte_set && m_set_classes[s.set][byte_class])
+    {
+      next.push_back(s.next);
+    }
+  }
+  if (!at_end) {
+    // Unanchored: a match may start at every position
+    next.push_back(m_start);
+  }
+  closure(next, false, at_end);
+
+  if (d.states.size() >= max_dfa_states) {
+    // Start over rather than grow without bound
+    d = dfa {};
+    std::vector<std::uint32_t> start = {m_start};
+    closure(start, true, false);
+    d.start = add_dfa_state(d, std::move(start));
+    return add_dfa_state(d, std::move(next));
+  }
+  const auto to = add_dfa_state(d, std::move(next));
+  d.transitions[from * columns + byte_class] = to;
+  return to;
+}
+
+regex::dfa& regex::this_thread_dfa() const
+{
+  thread_local std::vector<std::unique_ptr<dfa>> dfas;
+  if (dfas.size() <= m_id) {
+    dfas.resize(m_id + 1);
+  }
+  auto& d = dfas[m_id];
+  if (!d) {
+    d = std::make_unique<dfa>();
+    std::vector<std::uint32_t> start = {m_start};
+    closure(start, true, false);
+    d->start = add_dfa_state(*d, std::move(start));
+  }
+  return *d;
+}
+
+bool regex::search(std::string_view text) const
+{
+  if (text.empty()) {
+    // The only position is both the beginning and the end, e.g., for
+    // `$^`, which the DFA's cached transitions cannot tell apart
+    std::vector<std::uint32_t> states = {m_start};
+    closure(states, true, true);
+    return std::any_of(states.begin(),
+                       states.end(),
+                       [this](std::uint32_t i)
+                       { return m_states[i].kind == state::match; });
+  }
+
+  auto& d = this_thread_dfa();
+  auto current = d.start;
+  for (const auto c : text) {
+    if (d.accepting[current]) {
+      return true;
+    }
+    current = step(d, current, m_class[static_cast<unsigned char>(c)]);
+  }
+  if (d.accepting[current]) {
+    return true;
+  }
+  return d.accepting[step(d, current, m_class_count)];
+}
+
+}  // namespace search
@@ -0,0 +1,95 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace search
+{
+// The syntax tree of a pattern
+struct regex_node;
+
+// A regular expression for --regex. The pattern is compiled to an NFA,
+// and texts are matched with a DFA built from it lazily, a state at a
+// time, as the text needs it. Matching is linear in the length of the
+// text whatever the pattern: there is no backtracking.
+//
+// Syntax: literal bytes, `.` (anything but a newline), classes such as
+// `[a-z_]` and `[^0-9]`, `\d`, `\w`, `\s` and their negations `\D`,
+// `\W`, `\S`, escaped metacharacters, the repetitions `*`, `+`, `?`,
+// `{n}`, `{n,}` and `{n,m}`, alternation `|`, grouping `(...)`, and the
+// anchors `^` and `$`. There are no captures or backreferences.
+class regex
+{
+public:
+  // Returns false, with a message in `error`, if the pattern is invalid.
+  // With `ignore_case`, ASCII letters match in either case.
+  bool compile(std::string_view pattern,
+               std::string& error,
+               bool ignore_case = false);
+
+  // True if the pattern matches anywhere in `text`. Thread-safe: every
+  // thread builds a DFA of its own.
+  bool search(std::string_view text) const;
+
+  // At least one of these occurs in every text the pattern matches, so a
+  // file with none of them cannot have a match. Empty if the pattern
+  // requires no literal, e.g., `.*`. With ignore_case, they occur in some
+  // mix of cases.
+  const std::vector<std::string>& required_literals() const
+  {
+    return m_literals;
+  }
+
+private:
+  struct state
+  {
+    enum kind_type : std::uint8_t
+    {
+      // Consumes one byte in m_sets[set]
+      byte_set,
+      // Goes on to both next and alt without consuming anything
+      split,
+      // Goes on to next at the beginning of the text
+      begin,
+      // Goes on to next at the end of the text
+      end,
+      match,
+    };
+    kind_type kind;
+    std::uint32_t next {0};
+    std::uint32_t alt {0};
+    std::uint32_t set {0};
+  };
+
+  struct dfa;
+
+  std::uint32_t add_state(state s);
+  std::uint32_t compile_node(const regex_node& n, std::uint32_t next);
+
+  void closure(std::vector<std::uint32_t>& states,
+               bool at_begin,
+               bool at_end) const;
+  std::uint32_t add_dfa_state(dfa& d, std::vector<std::uint32_t> states) const;
+  std::uint32_t step(dfa& d, std::uint32_t from, std::size_t byte_class) const;
+  dfa& this_thread_dfa() const;
+
+  std::vector<state> m_states;
+  std::uint32_t m_start {0};
+  std::vector<std::bitset<256>> m_sets;
+  // Bytes that no byte set tells apart share a class; the extra class
+  // m_class_count is the end of the text
+  std::array<std::uint16_t, 256> m_class {};
+  std::size_t m_class_count {1};
+  // m_set_classes[set][class]: the bytes of the class are in the set
+  std::vector<std::vector<bool>> m_set_classes;
+  std::vector<std::string> m_literals;
+  bool m_ignore_case {false};
+  // Tells the per-thread DFAs of different patterns apart
+  std::size_t m_id {0};
+};
+
+}  // namespace search
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstdio>
+
+#include <result_sink.hpp>
+#include <stats.hpp>
+
+namespace search
+{
+void result_sink::set_framing(std::string_view header,
+                              std::string_view separator,
+                              std::string_view footer)
+{
+  m_header = header;
+  m_separator = separator;
+  m_footer = footer;
+}
+
+void result_sink::add(file_results&& results)
+{
+  if (results.empty()) {
+    return;
+  }
+  const phase_timer timer(phase::output);
+  const std::scoped_lock lock(m_mutex);
+  if (m_ordered) {
+    m_pending.push_back(std::move(results));
+  } else {
+    write(results);
+  }
+}
+
+void result_sink::stream(file_results& results)
+{
+  if (results.empty()) {
+    return;
+  }
+  const phase_timer timer(phase::output);
+  {
+    const std::scoped_lock lock(m_mutex);
+    write(results);
+    std::fflush(stdout);
+  }
+  results.buffer.clear();
+  results.result_ends.clear();
+}
+
+void result_sink::flush()
+{
+  const phase_timer timer(phase::output);
+  const std::scoped_lock lock(m_mutex);
+  std::stable_sort(m_pending.begin(),
+                   m_pending.end(),
+                   [](const file_results& a, const file_results& b)
+                   { return a.path < b.path; });
+  for (const auto& results : m_pending) {
+    write(results);
+  }
+  m_pending.clear();
+  std::fflush(stdout);
+}
+
+void result_sink::finish()
+{
+  flush();
+  const phase_timer timer(phase::output);
+  const std::scoped_lock lock(m_mutex);
+  write_header();
+  std::fwrite(m_footer.data(), 1, m_footer.size(), stdout);
+  std::fflush(stdout);
+}
+
+void result_sink::write_header()
+{
+  if (!m_header_written) {
+    std::fwrite(m_header.data(), 1, m_header.size(), stdout);
+    m_header_written = true;
+  }
+}
+
+void result_sink::write(const file_results& results)
+{
+  write_header();
+  if (m_separator.empty()) {
+    std::fwrite(results.buffer.data(), 1, results.buffer.size(), stdout);
+    return;
+  }
+  std::size_t begin = 0;
+  for (const auto end : results.result_ends) {
+    if (!m_first_result) {
+      std::fwrite(m_separator.data(), 1, m_separator.size(), stdout);
+    }
+    m_first_result = false;
+    std::fwrite(results.buffer.data() + begin, 1, end - begin, stdout);
+    begin = end;
+  }
+}
+
+}  // namespace search
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace search
+{
+// The formatted results of one file, collected by the worker that
+// searched it before any of them are written out
+struct file_results
+{
+  explicit file_results(std::string_view file_path)
+      : path(file_path)
+  {
+  }
+
+  // Marks the end of the result just formatted into `buffer`
+  void end_result()
+  {
+    result_ends.push_back(buffer.size());
+    ++result_count;
+  }
+
+  bool empty() const { return result_ends.empty(); }
+
+  std::string path;
+  fmt::memory_buffer buffer;
+  std::vector<std::size_t> result_ends;
+  // Unlike result_ends, not reset when the results are streamed
+  std::size_t result_count {0};
+};
+
+// Writes the results of all files to stdout from one place, a whole file
+// at a time, so the results of different files never interleave.
+//
+// By default, results are held until flush() and written in path order,
+// which makes the output the same from run to run whatever the number of
+// threads. Unordered, each file is written as soon as it is done.
+// Streaming, each result is written as soon as it is found, and the
+// file's buffer is cleared to be reused for the next one.
+class result_sink
+{
+public:
+  // The output is `header`, the results separated by `separator`, then
+  // `footer`, e.g., "[", "," and "]" for a JSON array
+  void set_framing(std::string_view header,
+                   std::string_view separator,
+                   std::string_view footer);
+  void set_ordered(bool ordered) { m_ordered = ordered; }
+  void set_streaming(bool streaming) { m_streaming = streaming; }
+  bool streaming() const { return m_streaming; }
+
+  // Thread-safe
+  void add(file_results&& results);
+
+  // Thread-safe; writes the results in `results` now and clears it
+  void stream(file_results& results);
+
+  // Writes the results held so far
+  void flush();
+
+  // Writes the remaining results and the footer
+  void finish();
+
+private:
+  void write(const file_results& results);
+  void write_header();
+
+  std::mutex m_mutex;
+  bool m_ordered {true};
+  bool m_streaming {false};
+  std::vector<file_results> m_pending;
+
+  std::string m_header;
+  std::string m_separator;
+  std::string m_footer;
+  bool m_header_written {false};
+  bool m_first_result {true};
+};
+
+}  // namespace search
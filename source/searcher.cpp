@@ -1,21 +1,31 @@
+#include <aho_corasick.hpp>
 #include <algorithm>
 #include <array>
-#include <fnmatch.h>
+#include <bitset>
+#include <condition_variable>
+#include <deque>
+#include <dirent.h>
+#include <glob.hpp>
+#include <ignore_rules.hpp>
 #include <lexer.hpp>
+#include <mutex>
 #include <searcher.hpp>
+#include <stats.hpp>
+#include <sys/stat.h>
 namespace fs = std::filesystem;
 
 #include <clang-c/Index.h>  // This is libclang.
 
 namespace
 {
-void print_code_snippet(std::string_view filename,
-                    bool is_stdout,
-                    unsigned start_line,
-                    unsigned end_line,
-                    std::string_view code_snippet)
+void print_code_snippet(fmt::memory_buffer& out,
+                        std::string_view filename,
+                        bool is_stdout,
+                        unsigned start_line,
+                        unsigned end_line,
+                        std::string_view code_snippet,
+                        const search::query& query)
 {
-  auto out = fmt::memory_buffer();
   if (is_stdout) {
     fmt::format_to(
         std::back_inserter(out), "\n\033[1;90m// {}\033[0m ", filename);
@@ -25,77 +35,132 @@ void print_code_snippet(std::string_view filename,
 
   if (is_stdout) {
     fmt::format_to(std::back_inserter(out),
-                   "\033[1;90m(Line: {} to {})\033[0m\n",
+                   "\033[1;90m(Line: {} to {})\033[0m",
                    start_line,
                    end_line);
   } else {
     fmt::format_to(
-        std::back_inserter(out), "(Line: {} to {})\n", start_line, end_line);
+        std::back_inserter(out), "(Line: {} to {})", start_line, end_line);
   }
+
+  // Results of --queries-from say which query they are for
+  if (query.id != 0 && is_stdout) {
+    fmt::format_to(std::back_inserter(out),
+                   " \033[1;90m(Query {}: {})\033[0m",
+                   query.id,
+                   query.text);
+  } else if (query.id != 0) {
+    fmt::format_to(
+        std::back_inserter(out), " (Query {}: {})", query.id, query.text);
+  }
+  fmt::format_to(std::back_inserter(out), "\n");
   lexer lex;
   lex.tokenize_and_pretty_print(code_snippet, &out, is_stdout);
   fmt::format_to(std::back_inserter(out), "\n");
-  fmt::print("{}", fmt::to_string(out));
 }
 
-bool exclude_directory(const char* path)
+// --files-with-matches prints the file name alone
+void print_file_name(fmt::memory_buffer& out,
+                     std::string_view filename,
+                     bool is_stdout)
 {
-  static const std::array<const char*, 35> ignored_dirs = {
-      ".git/",         ".github/",       "build/",
-      "node_modules/", ".vscode/",       ".DS_Store/",
-      "debugPublic/",  "DebugPublic/",   "debug/",
-      "Debug/",        "Release/",       "release/",
-      "Releases/",     "releases/",      "cmake-build-debug/",
-      "__pycache__/",  "Binaries/",      "Doc/",
-      "doc/",          "Documentation/", "docs/",
-      "Docs/",         "bin/",           "Bin/",
-      "patches/",      "tar-install/",   "CMakeFiles/",
-      "install/",      "snap/",          "LICENSES/",
-      "img/",          "images/",        "imgs/",
-      ".cache/",       ".github/"};
-
-  return std::any_of(ignored_dirs.cbegin(),
-                     ignored_dirs.cend(),
-                     [path](const char* ignored_dir) -> bool
-                     { return strstr(path, ignored_dir) != nullptr; });
+  if (is_stdout) {
+    fmt::format_to(std::back_inserter(out), "\033[1;90m{}\033[0m\n", filename);
+  } else {
+    fmt::format_to(std::back_inserter(out), "{}\n", filename);
+  }
 }
 
+// One CXIndex per thread, created on first use and disposed when the
+// thread exits (i.e., when the thread pool shuts down).
+class thread_index
+{
+  CXIndex m_index {nullptr};
+
+public:
+  thread_index() = default;
+  thread_index(const thread_index&) = delete;
+  thread_index& operator=(const thread_index&) = delete;
+
+  ~thread_index()
+  {
+    if (m_index) {
+      clang_disposeIndex(m_index);
+    }
+  }
+
+  CXIndex get(bool display_diagnostics)
+  {
+    if (!m_index) {
+      m_index = clang_createIndex(0, display_diagnostics ? 1 : 0);
+    }
+    return m_index;
+  }
+};
+
+thread_local thread_index this_thread_index;
+
 }  // namespace
 
 namespace search
 {
+bool equal_ignoring_case(char a, char b)
+{
+  const auto lower = [](char c)
+  { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c; };
+  return lower(a) == lower(b);
+}
+
+bool equal_ignoring_case(std::string_view a, std::string_view b)
+{
+  return a.size() == b.size()
+      && std::equal(a.begin(),
+                    a.end(),
+                    b.begin(),
+                    [](char x, char y) { return equal_ignoring_case(x, y); });
+}
+
 auto needle_search(std::string_view needle,
                    std::string_view::const_iterator haystack_begin,
-                   std::string_view::const_iterator haystack_end)
+                   std::string_view::const_iterator haystack_end,
+                   bool ignore_case)
     -> std::string_view::const_iterator
 {
-  if (haystack_begin != haystack_end) {
+  if (haystack_begin == haystack_end) {
+    return haystack_end;
+  } else if (ignore_case) {
+    return std::search(haystack_begin,
+                       haystack_end,
+                       needle.begin(),
+                       needle.end(),
+                       [](char a, char b)
+                       { return equal_ignoring_case(a, b); });
+  } else {
     return std::search(
         haystack_begin, haystack_end, needle.begin(), needle.end());
-  } else {
-    return haystack_end;
   }
 }
 
-void searcher::file_search(std::string_view filename, std::string_view haystack)
-
+// True if `needle` occurs anywhere in the haystack. With `ignore_case`,
+// the SIMD kernel folds case in its registers, so nothing is copied.
+bool contains_query(std::string_view needle,
+                    std::string_view haystack,
+                    std::size_t padding,
+                    bool ignore_case)
 {
   // Start from the beginning
   const auto haystack_begin = haystack.cbegin();
   const auto haystack_end = haystack.cend();
 
   auto it = haystack_begin;
-  bool first_search = true;
-  bool printed_file_name = false;
-  std::size_t current_line_number = 1;
-  auto no_file_name = filename.empty();
 
 #if defined(__SSE2__)
   std::string_view view(it, haystack_end - it);
   if (view.empty()) {
     it = haystack_end;
   } else {
-    auto pos = sse2_strstr_v2(std::string_view(it, haystack_end - it), m_query);
+    auto pos = ignore_case ? simd_strcasestr(view, needle, padding)
+                           : simd_strstr(view, needle, padding);
     if (pos != std::string::npos) {
       it += pos;
     } else {
@@ -103,291 +168,843 @@ void searcher::file_search(std::string_view filename, std::string_view haystack)
     }
   }
 #else
-  it = needle_search(m_query, it, haystack_end);
+  it = needle_search(needle, it, haystack_end, ignore_case);
 #endif
 
-  if (it != haystack_end) {
-    // analyze file
-    const char* path = filename.data();
-    if (searcher::m_verbose) {
-      fmt::print("Checking {}\n", path);
+  return it != haystack_end;
+}
+
+// Declaration kinds whose extent does not depend on any function body.
+// Functions are not on this list: their reported extent is the whole
+// definition, and a skipped body would cut the snippet short.
+bool only_declarations_requested(const query& q)
+{
+  return !(q.search_expressions || q.search_for_member_function
+           || q.search_for_function || q.search_for_function_template
+           || q.search_for_class_constructor || q.search_for_class_destructor
+           || q.search_for_variable_declaration
+           || q.search_for_parameter_declaration || q.search_for_static_cast
+           || q.search_for_dynamic_cast || q.search_for_reinterpret_cast
+           || q.search_for_const_cast || q.search_for_throw_expression
+           || q.search_for_for_statement);
+}
+
+// Function declarations still need their bodies, but nothing else
+// that can only show up inside a function body is searched for
+bool only_declarations_and_functions_requested(const query& q)
+{
+  return !(q.search_expressions || q.search_for_variable_declaration
+           || q.search_for_parameter_declaration || q.search_for_static_cast
+           || q.search_for_dynamic_cast || q.search_for_reinterpret_cast
+           || q.search_for_const_cast || q.search_for_throw_expression
+           || q.search_for_for_statement);
+}
+
+unsigned translation_unit_flags()
+{
+  unsigned flags = CXTranslationUnit_KeepGoing
+      | CXTranslationUnit_IgnoreNonErrorsFromIncludedFiles;
+
+  if (searcher::m_index.is_open()) {
+    // Indexed files record every kind of cursor, so they need the
+    // complete AST
+    return flags;
+  }
+
+  // Every query has to be answered from the same parse
+  const auto all_queries = [](bool (*predicate)(const query&))
+  {
+    return std::all_of(
+        searcher::m_queries.begin(), searcher::m_queries.end(), predicate);
+  };
+
+  if (all_queries(only_declarations_requested)) {
+    // Declarations are all that is needed - skip parsing function
+    // bodies and the end-of-TU work (e.g., template instantiation)
+    flags |= CXTranslationUnit_SkipFunctionBodies
+        | CXTranslationUnit_Incomplete;
+  } else if (all_queries(only_declarations_and_functions_requested)) {
+    flags |= CXTranslationUnit_Incomplete;
+  }
+
+  return flags;
+}
+
+bool is_expression_kind(unsigned kind)
+{
+  return kind == CXCursor_DeclRefExpr || kind == CXCursor_MemberRefExpr
+      || kind == CXCursor_MemberRef || kind == CXCursor_FieldDecl;
+}
+
+// For these, the query is checked against the code snippet (once it is
+// available) instead of the cursor spelling
+bool query_matches_snippet(const query& q)
+{
+  return q.search_for_throw_expression || q.search_for_typedef
+      || q.search_for_static_cast || q.search_for_dynamic_cast
+      || q.search_for_reinterpret_cast || q.search_for_const_cast
+      || q.search_for_for_statement;
+}
+
+/*
+  CXCursor_CXXStaticCastExpr
+  C++'s static_cast<> expression.
+
+  CXCursor_CXXDynamicCastExpr
+  C++'s dynamic_cast<> expression.
+
+  CXCursor_CXXReinterpretCastExpr
+  C++'s reinterpret_cast<> expression.
+
+  CXCursor_CXXConstCastExpr
+  C++'s const_cast<> expression.
+*/
+bool is_searched_kind(const query& q, unsigned kind)
+{
+  return (q.search_expressions && is_expression_kind(kind))
+      || (q.search_for_enum && kind == CXCursor_EnumDecl)
+      || (q.search_for_struct && kind == CXCursor_StructDecl)
+      || (q.search_for_union && kind == CXCursor_UnionDecl)
+      || (q.search_for_member_function && kind == CXCursor_CXXMethod)
+      || (q.search_for_function && kind == CXCursor_FunctionDecl)
+      || (q.search_for_function_template && kind == CXCursor_FunctionTemplate)
+      || (q.search_for_class && kind == CXCursor_ClassDecl)
+      || (q.search_for_class_template && kind == CXCursor_ClassTemplate)
+      || (q.search_for_class_constructor && kind == CXCursor_Constructor)
+      || (q.search_for_class_destructor && kind == CXCursor_Destructor)
+      || (q.search_for_typedef && kind == CXCursor_TypedefDecl)
+      || (q.search_for_using_declaration
+          && (kind == CXCursor_UsingDirective
+              || kind == CXCursor_UsingDeclaration
+              || kind == CXCursor_TypeAliasDecl))
+      || (q.search_for_namespace_alias && kind == CXCursor_NamespaceAlias)
+      || (q.search_for_variable_declaration && kind == CXCursor_VarDecl)
+      || (q.search_for_parameter_declaration && kind == CXCursor_ParmDecl)
+      || (q.search_for_static_cast && kind == CXCursor_CXXStaticCastExpr)
+      || (q.search_for_dynamic_cast && kind == CXCursor_CXXDynamicCastExpr)
+      || (q.search_for_reinterpret_cast
+          && kind == CXCursor_CXXReinterpretCastExpr)
+      || (q.search_for_const_cast && kind == CXCursor_CXXConstCastExpr)
+      || (q.search_for_throw_expression && kind == CXCursor_CXXThrowExpr)
+      || (q.search_for_for_statement
+          && (kind == CXCursor_ForStmt || kind == CXCursor_CXXForRangeStmt));
+}
+
+// Every kind of cursor fccf can report, whatever is searched for
+bool is_indexed_kind(unsigned kind)
+{
+  switch (kind) {
+    case CXCursor_DeclRefExpr:
+    case CXCursor_MemberRefExpr:
+    case CXCursor_MemberRef:
+    case CXCursor_FieldDecl:
+    case CXCursor_EnumDecl:
+    case CXCursor_StructDecl:
+    case CXCursor_UnionDecl:
+    case CXCursor_CXXMethod:
+    case CXCursor_FunctionDecl:
+    case CXCursor_FunctionTemplate:
+    case CXCursor_ClassDecl:
+    case CXCursor_ClassTemplate:
+    case CXCursor_Constructor:
+    case CXCursor_Destructor:
+    case CXCursor_TypedefDecl:
+    case CXCursor_UsingDirective:
+    case CXCursor_UsingDeclaration:
+    case CXCursor_TypeAliasDecl:
+    case CXCursor_NamespaceAlias:
+    case CXCursor_VarDecl:
+    case CXCursor_ParmDecl:
+    case CXCursor_CXXStaticCastExpr:
+    case CXCursor_CXXDynamicCastExpr:
+    case CXCursor_CXXReinterpretCastExpr:
+    case CXCursor_CXXConstCastExpr:
+    case CXCursor_CXXThrowExpr:
+    case CXCursor_ForStmt:
+    case CXCursor_CXXForRangeStmt:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Cursor kinds are small numbers; every kind that can be searched for is
+// below this one
+constexpr unsigned kind_count = 256;
+static_assert(CXCursor_CXXForRangeStmt < kind_count);
+
+// Indices into searcher::m_queries
+using query_list = std::vector<std::uint32_t>;
+
+// Literal i belongs to query queries[i]
+struct literal_set
+{
+  std::vector<std::string> literals;
+  query_list queries;
+  // With more than a few literals, the automaton that looks for all of
+  // them in one pass
+  std::unique_ptr<aho_corasick> automaton;
+  bool ignore_case {false};
+};
+
+// What the search needs to know about searcher::m_queries, worked out
+// once, before the first file is searched
+struct query_plan
+{
+  // The kinds of cursors each query looks at
+  std::vector<std::bitset<kind_count>> kinds;
+  query_list all;
+  // Queries that no file can be ruled out for, e.g., an empty query
+  query_list unconditional;
+  // What the prefilter looks for, apart from the literals of --ignore-case
+  // queries. A file can only match a query if it contains one of its
+  // literals.
+  literal_set literals;
+  literal_set ignore_case_literals;
+};
+
+// Up to this many literals are looked for one at a time with
+// simd_strstr, which is faster per byte than the automaton
+constexpr std::size_t max_simd_literals = 4;
+
+const query_plan& plan()
+{
+  static const query_plan p = []
+  {
+    query_plan p;
+    p.ignore_case_literals.ignore_case = true;
+    for (std::uint32_t i = 0; i < searcher::m_queries.size(); ++i) {
+      const auto& q = searcher::m_queries[i];
+      auto& kinds = p.kinds.emplace_back();
+      for (unsigned kind = 0; kind < kind_count; ++kind) {
+        kinds[kind] = is_searched_kind(q, kind);
+      }
+      p.all.push_back(i);
+
+      // A --regex pattern brings the literals every match contains
+      std::vector<std::string> literals;
+      if (q.pattern) {
+        literals = q.pattern->required_literals();
+      } else if (!q.text.empty()) {
+        literals = {q.text};
+      }
+      if (q.text.empty() || literals.empty()) {
+        p.unconditional.push_back(i);
+        continue;
+      }
+      auto& set = q.ignore_case ? p.ignore_case_literals : p.literals;
+      for (auto& literal : literals) {
+        set.literals.push_back(std::move(literal));
+        set.queries.push_back(i);
+      }
+    }
+    for (auto* set : {&p.literals, &p.ignore_case_literals}) {
+      if (set->literals.size() > max_simd_literals) {
+        set->automaton = std::make_unique<aho_corasick>(
+            std::vector<std::string_view>(set->literals.begin(),
+                                          set->literals.end()),
+            set->ignore_case);
+      }
+    }
+    return p;
+  }();
+  return p;
+}
+
+// Whether query i looks at cursors of this kind
+bool is_searched_by(std::uint32_t i, unsigned kind)
+{
+  return kind < kind_count && plan().kinds[i][kind];
+}
+
+// Resolves the lines and the code snippet range of a cursor
+indexed_cursor make_cursor(CXCursor c,
+                           std::string_view haystack,
+                           std::string_view spelling)
+{
+  auto source_range = clang_getCursorExtent(c);
+  auto start_location = clang_getRangeStart(source_range);
+  auto end_location = clang_getRangeEnd(source_range);
+
+  CXFile file;
+  unsigned start_line, start_column, start_offset;
+  clang_getExpansionLocation(
+      start_location, &file, &start_line, &start_column, &start_offset);
+
+  unsigned end_line, end_column, end_offset;
+  clang_getExpansionLocation(
+      end_location, &file, &end_line, &end_column, &end_offset);
+
+  auto pos = source_range.begin_int_data - 2;
+  auto count = source_range.end_int_data - source_range.begin_int_data;
+
+  if (is_expression_kind(c.kind) && pos < haystack.size()) {
+    // Update pos and count so that the entire line of code is
+    // printed instead of just the reference (e.g., variable
+    // name)
+    auto newline_before = haystack.rfind('\n', pos);
+    while (haystack[newline_before + 1] == ' '
+           || haystack[newline_before + 1] == '\t')
+    {
+      newline_before += 1;
+    }
+    auto newline_after = haystack.find('\n', pos);
+    pos = newline_before + 1;
+    count = newline_after - newline_before - 1;
+  }
+
+  return {static_cast<std::uint32_t>(c.kind),
+          start_line,
+          end_line,
+          pos,
+          count,
+          spelling};
+}
+
+// True if the query, or a match of its --regex pattern, occurs in `text`
+bool contains_query_text(const query& q, std::string_view text)
+{
+  if (q.pattern) {
+    return q.pattern->search(text);
+  } else if (q.ignore_case) {
+    return contains_query(q.text, text, 0, true);
+  }
+  return text.find(q.text) != std::string_view::npos;
+}
+
+// True if the name is the query, for --exact-match
+bool is_query_text(const query& q, std::string_view name)
+{
+  if (q.exact_pattern) {
+    return q.exact_pattern->search(name);
+  } else if (q.ignore_case) {
+    return equal_ignoring_case(name, q.text);
+  }
+  return name == q.text;
+}
+
+// Checks everything about a cursor that does not need the file content
+bool matches_query(const query& q, const indexed_cursor& cursor)
+{
+  if (!((!searcher::m_ignore_single_line_results
+         && cursor.end_line >= cursor.start_line)
+        || (searcher::m_ignore_single_line_results
+            && cursor.end_line > cursor.start_line)))
+  {
+    return false;
+  }
+
+  std::string_view name = cursor.spelling;
+  std::string_view query = q.text;
+
+  return query.empty()
+      || (
+             // The query check for these is done
+             // a little later down the road
+             // (once a code snippet is available
+             // to check against)
+             query_matches_snippet(q))
+      || (q.exact_match && !is_expression_kind(cursor.kind)
+          && is_query_text(q, name))
+      || (!q.exact_match && contains_query_text(q, name));
+}
+
+bool is_cancelled()
+{
+  return searcher::m_cancelled.load(std::memory_order_relaxed);
+}
+
+// Takes one of the --max-results slots, false once all of them are
+// taken. Taking the last one cancels the rest of the search.
+bool claim_result()
+{
+  if (searcher::m_max_results == 0) {
+    return true;
+  }
+  static std::atomic<std::size_t> claimed {0};
+  const auto count = claimed.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (count >= searcher::m_max_results) {
+    searcher::m_cancelled.store(true, std::memory_order_relaxed);
+  }
+  return count <= searcher::m_max_results;
+}
+
+// Formats the cursor, a match for `q`, into `results`. Returns true if it
+// was reported.
+bool report_cursor(const query& q,
+                   const indexed_cursor& cursor,
+                   std::string_view haystack,
+                   file_results& results)
+{
+  if (cursor.pos >= haystack.size()
+      || (searcher::m_files_with_matches && results.result_count > 0))
+  {
+    return false;
+  }
+
+  auto code_snippet = haystack.substr(cursor.pos, cursor.count);
+
+  // Handles throw expression, static_cast,
+  // dynamic_cast, const_cast, reinterpret_cast
+  // for_statement, and ranged_for_statement
+  //
+  // if the `query` is part of the code snippet,
+  // then show result, else, skip it
+  if (query_matches_snippet(q) && !contains_query_text(q, code_snippet))
+  {
+    return false;
+  }
+
+  if (!claim_result()) {
+    return false;
+  }
+  stats::add(counter::results);
+
+  if (searcher::m_count_only) {
+    ++results.result_count;
+    searcher::m_counts.add_kind(cursor.kind);
+    return true;
+  }
+
+  phase_timer timer(phase::format);
+  timer.annotate(results.path, code_snippet.size());
+  if (searcher::m_files_with_matches) {
+    print_file_name(results.buffer, results.path, searcher::m_is_stdout);
+  } else if (searcher::m_custom_printer) {
+    searcher::m_custom_printer(results.buffer,
+                               results.path,
+                               searcher::m_is_stdout,
+                               cursor.start_line,
+                               cursor.end_line,
+                               code_snippet,
+                               q.id);
+  } else {
+    print_code_snippet(results.buffer,
+                       results.path,
+                       searcher::m_is_stdout,
+                       cursor.start_line,
+                       cursor.end_line,
+                       code_snippet,
+                       q);
+  }
+  results.end_result();
+  if (searcher::m_results.streaming()) {
+    searcher::m_results.stream(results);
+  }
+  return true;
+}
+
+// Hands over the results of a file once it has been searched
+void finish_file(file_results&& results)
+{
+  if (searcher::m_count_only) {
+    if (results.result_count > 0) {
+      searcher::m_counts.add_file(results.path, results.result_count);
+    }
+    return;
+  }
+  searcher::m_results.add(std::move(results));
+}
+
+bool has_errors(CXTranslationUnit unit)
+{
+  const auto count = clang_getNumDiagnostics(unit);
+  for (unsigned i = 0; i < count; ++i) {
+    CXDiagnostic diagnostic = clang_getDiagnostic(unit, i);
+    const auto severity = clang_getDiagnosticSeverity(diagnostic);
+    clang_disposeDiagnostic(diagnostic);
+    if (severity >= CXDiagnostic_Error) {
+      return true;
     }
+  }
+  return false;
+}
+
+// Reads a whole file, timed for --stats and --trace
+file_contents read_file(const char* path)
+{
+  phase_timer timer(phase::read);
+  file_contents contents(path);
+  timer.annotate(path, contents.view().size());
+  return contents;
+}
+
+// The cursors recorded for the declaration index while visiting a file
+struct cursor_collector
+{
+  std::vector<indexed_cursor> cursors;
+  std::deque<std::string> spellings;
+};
+
+// Looks for the given queries in the file. Returns false if the visit
+// stopped early, i.e., not every cursor was collected.
+bool parse_and_search(std::string_view filename,
+                      std::string_view haystack,
+                      const query_list& queries,
+                      cursor_collector* collector)
+{
+  const char* path = filename.data();
+  if (searcher::m_verbose) {
+    fmt::print("Checking {}\n", path);
+  }
+
+  std::vector<const char*> clang_options;
+  std::string parent_path_str, grandparent_path_str;
+  std::string source_path;
 
+  if (const auto* arguments = searcher::m_compilation_database.find(filename))
+  {
+    // Use the exact flags this file is built with. They start with
+    // -working-directory, which a relative path would be resolved against.
+    source_path = compilation_database::key(filename);
+    path = source_path.c_str();
+    clang_options.reserve(arguments->size());
+    for (const auto& argument : *arguments) {
+      clang_options.push_back(argument.c_str());
+    }
+  } else {
     // Update a copy of the clang options
     // Include
-    auto clang_options = m_clang_options;
+    clang_options = searcher::m_clang_options;
     auto parent_path = fs::path(filename).parent_path();
-    auto parent_path_str = "-I" + parent_path.string();
+    parent_path_str = "-I" + parent_path.string();
     auto grandparent_path = parent_path.parent_path();
-    auto grandparent_path_str = "-I" + grandparent_path.string();
+    grandparent_path_str = "-I" + grandparent_path.string();
     clang_options.push_back(parent_path_str.c_str());
     clang_options.push_back(grandparent_path_str.c_str());
     clang_options.push_back("-I/usr/include");
     clang_options.push_back("-I/usr/local/include");
+  }
 
-    if (m_verbose) {
-      fmt::print("Clang options:\n");
-      for (auto& option : clang_options) {
-        fmt::print("{} ", option);
-      }
-      fmt::print("\n");
+  if (searcher::m_verbose) {
+    fmt::print("Clang options:\n");
+    for (auto& option : clang_options) {
+      fmt::print("{} ", option);
     }
+    fmt::print("\n");
+  }
 
-    CXIndex index;
+  CXIndex index = this_thread_index.get(searcher::m_verbose);
+  CXTranslationUnit unit = nullptr;
+  {
+    phase_timer timer(phase::parse);
+    timer.annotate(filename, haystack.size());
+    unit = clang_parseTranslationUnit(index,
+                                      path,
+                                      clang_options.data(),
+                                      clang_options.size(),
+                                      nullptr,
+                                      0,
+                                      translation_unit_flags());
+  }
+  if (unit == nullptr) {
+    // Reported and skipped: the other files can still be searched
+    fmt::print(stderr, "Error: Unable to parse translation unit {}\n", path);
+    stats::add(counter::parse_failures);
+    return false;
+  }
+  stats::add(counter::translation_units);
+  if (stats::m_enabled && has_errors(unit)) {
+    stats::add(counter::parse_failures);
+  }
 
-    if (searcher::m_verbose) {
-      index = clang_createIndex(0, 1);
-    } else {
-      index = clang_createIndex(0, 0);
+  CXCursor cursor = clang_getTranslationUnitCursor(unit);
+
+  struct client_args
+  {
+    std::string_view haystack;
+    const query_list& queries;
+    // The kinds any of the queries looks at
+    std::bitset<kind_count> kinds;
+    cursor_collector* collector;
+    file_results results;
+  };
+  client_args args = {haystack, queries, {}, collector, file_results(filename)};
+  for (const auto i : queries) {
+    args.kinds |= plan().kinds[i];
+  }
+
+  bool stopped = false;
+  {
+    phase_timer timer(phase::visit);
+    timer.annotate(filename, haystack.size());
+    stopped = clang_visitChildren(
+        cursor,
+        [](CXCursor c, CXCursor parent, CXClientData client_data)
+        {
+          if (is_cancelled()) {
+            return CXChildVisit_Break;
+          }
+
+          // Declarations pulled in from included headers are
+          // skipped, along with everything nested inside them
+          if (searcher::m_main_file_only
+              && !clang_Location_isFromMainFile(clang_getCursorLocation(c)))
+          {
+            return CXChildVisit_Continue;
+          }
+
+          client_args* args = (client_args*)client_data;
+          const bool searched = c.kind < kind_count && args->kinds[c.kind];
+          if (!searched && !(args->collector && is_indexed_kind(c.kind))) {
+            return CXChildVisit_Recurse;
+          }
+
+          CXString spelling = clang_getCursorSpelling(c);
+          const char* name = clang_getCString(spelling);
+          auto result = make_cursor(c, args->haystack, name ? name : "");
+
+          if (args->collector && result.pos < args->haystack.size()) {
+            result.spelling =
+                args->collector->spellings.emplace_back(result.spelling);
+            args->collector->cursors.push_back(result);
+          }
+          bool done = false;
+          for (std::size_t j = 0; searched && !done && j < args->queries.size();
+               ++j)
+          {
+            const auto i = args->queries[j];
+            const auto& q = searcher::m_queries[i];
+            if (is_searched_by(i, c.kind) && matches_query(q, result)
+                && report_cursor(q, result, args->haystack, args->results))
+            {
+              // The first result is all --files-with-matches needs,
+              // unless the file is being indexed
+              done = searcher::m_files_with_matches && !args->collector;
+            }
+          }
+
+          clang_disposeString(spelling);
+          return done ? CXChildVisit_Break : CXChildVisit_Recurse;
+        },
+        (void*)(&args))
+        != 0;
+  }
+
+  clang_disposeTranslationUnit(unit);
+  finish_file(std::move(args.results));
+  return !stopped;
+}
+
+// Adds the queries of the literals in the haystack to `found`
+void find_literals(const literal_set& set,
+                   std::string_view haystack,
+                   std::size_t padding,
+                   query_list& found)
+{
+  if (set.automaton) {
+    // One pass over the file, whatever the number of literals
+    std::vector<bool> found_literals(set.literals.size());
+    set.automaton->find(haystack, found_literals);
+    for (std::size_t i = 0; i < set.literals.size(); ++i) {
+      if (found_literals[i]) {
+        found.push_back(set.queries[i]);
+      }
     }
-    CXTranslationUnit unit = clang_parseTranslationUnit(
-        index,
-        path,
-        clang_options.data(),
-        clang_options.size(),
-        nullptr,
-        0,
-        CXTranslationUnit_KeepGoing
-            | CXTranslationUnit_IgnoreNonErrorsFromIncludedFiles);
-    // CXTranslationUnit_None);
-    if (unit == nullptr) {
-      fmt::print("Error: Unable to parse translation unit {}. Quitting.\n",
-                 path);
-      std::exit(-1);
+  } else {
+    // A few literals are cheaper to look for one at a time with the SIMD
+    // kernel
+    for (std::size_t i = 0; i < set.literals.size(); ++i) {
+      const auto query = set.queries[i];
+      if (std::find(found.begin(), found.end(), query) == found.end()
+          && contains_query(
+              set.literals[i], haystack, padding, set.ignore_case))
+      {
+        found.push_back(query);
+      }
     }
+  }
+}
 
-    CXCursor cursor = clang_getTranslationUnitCursor(unit);
+// The prefilter: the queries that occur anywhere in the file, in query
+// order. Files with none are not parsed.
+query_list prefilter(std::string_view path,
+                     std::string_view haystack,
+                     std::size_t padding)
+{
+  phase_timer timer(phase::prefilter);
+  timer.annotate(path, haystack.size());
+  stats::add(counter::bytes_scanned, haystack.size());
 
-    struct client_args
-    {
-      std::string_view filename;
-      std::string_view haystack;
-      custom_printer_callback printer;
-    };
-    client_args args = {filename, haystack, m_custom_printer};
-
-    if (clang_visitChildren(
-            cursor,
-            [](CXCursor c, CXCursor parent, CXClientData client_data)
-            {
-              client_args* args = (client_args*)client_data;
-              auto filename = args->filename;
-              auto haystack = args->haystack;
-              auto printer = args->printer;
-
-              /*
-                CXCursor_CXXStaticCastExpr
-                C++'s static_cast<> expression.
-
-                CXCursor_CXXDynamicCastExpr
-                C++'s dynamic_cast<> expression.
-
-                CXCursor_CXXReinterpretCastExpr
-                C++'s reinterpret_cast<> expression.
-
-                CXCursor_CXXConstCastExpr
-                C++'s const_cast<> expression.
-              */
-
-              if ((searcher::m_search_expressions
-                   && (c.kind == CXCursor_DeclRefExpr
-                       || c.kind == CXCursor_MemberRefExpr
-                       || c.kind == CXCursor_MemberRef
-                       || c.kind == CXCursor_FieldDecl))
-                  || (searcher::m_search_for_enum
-                      && c.kind == CXCursor_EnumDecl)
-                  || (searcher::m_search_for_struct
-                      && c.kind == CXCursor_StructDecl)
-                  || (searcher::m_search_for_union
-                      && c.kind == CXCursor_UnionDecl)
-                  || (searcher::m_search_for_member_function
-                      && c.kind == CXCursor_CXXMethod)
-                  || (searcher::m_search_for_function
-                      && c.kind == CXCursor_FunctionDecl)
-                  || (searcher::m_search_for_function_template
-                      && c.kind == CXCursor_FunctionTemplate)
-                  || (searcher::m_search_for_class
-                      && c.kind == CXCursor_ClassDecl)
-                  || (searcher::m_search_for_class_template
-                      && c.kind == CXCursor_ClassTemplate)
-                  || (searcher::m_search_for_class_constructor
-                      && c.kind == CXCursor_Constructor)
-                  || (searcher::m_search_for_class_destructor
-                      && c.kind == CXCursor_Destructor)
-                  || (searcher::m_search_for_typedef
-                      && c.kind == CXCursor_TypedefDecl)
-                  || (searcher::m_search_for_using_declaration
-                      && (c.kind == CXCursor_UsingDirective
-                          || c.kind == CXCursor_UsingDeclaration
-                          || c.kind == CXCursor_TypeAliasDecl))
-                  || (searcher::m_search_for_namespace_alias
-                      && c.kind == CXCursor_NamespaceAlias)
-                  || (searcher::m_search_for_variable_declaration
-                      && c.kind == CXCursor_VarDecl)
-                  || (searcher::m_search_for_parameter_declaration
-                      && c.kind == CXCursor_ParmDecl)
-                  || (searcher::m_search_for_static_cast
-                      && c.kind == CXCursor_CXXStaticCastExpr)
-                  || (searcher::m_search_for_dynamic_cast
-                      && c.kind == CXCursor_CXXDynamicCastExpr)
-                  || (searcher::m_search_for_reinterpret_cast
-                      && c.kind == CXCursor_CXXReinterpretCastExpr)
-                  || (searcher::m_search_for_const_cast
-                      && c.kind == CXCursor_CXXConstCastExpr)
-                  || (searcher::m_search_for_throw_expression
-                      && c.kind == CXCursor_CXXThrowExpr)
-                  || (searcher::m_search_for_for_statement
-                      && (c.kind == CXCursor_ForStmt
-                          || c.kind == CXCursor_CXXForRangeStmt)))
-              {
-                // fmt::print("Found something in {}\n", filename);
-
-                auto source_range = clang_getCursorExtent(c);
-                auto start_location = clang_getRangeStart(source_range);
-                auto end_location = clang_getRangeEnd(source_range);
-
-                CXFile file;
-                unsigned start_line, start_column, start_offset;
-                clang_getExpansionLocation(start_location,
-                                           &file,
-                                           &start_line,
-                                           &start_column,
-                                           &start_offset);
-
-                unsigned end_line, end_column, end_offset;
-                clang_getExpansionLocation(
-                    end_location, &file, &end_line, &end_column, &end_offset);
-
-                if ((!searcher::m_ignore_single_line_results
-                     && end_line >= start_line)
-                    || (m_ignore_single_line_results && end_line > start_line))
-                {
-                  std::string_view name =
-                      (const char*)clang_getCursorSpelling(c).data;
-                  std::string_view query = searcher::m_query.data();
-
-                  if (query.empty()
-                      || (
-                          // The query check for these is done
-                          // a little later down the road
-                          // (once a code snippet is available
-                          // to check against)
-                          searcher::m_search_for_throw_expression
-                          || searcher::m_search_for_typedef
-                          || searcher::m_search_for_static_cast
-                          || searcher::m_search_for_dynamic_cast
-                          || searcher::m_search_for_reinterpret_cast
-                          || searcher::m_search_for_const_cast
-                          || searcher::m_search_for_for_statement)
-                      || (searcher::m_exact_match && name == query
-                          && c.kind != CXCursor_DeclRefExpr
-                          && c.kind != CXCursor_MemberRefExpr
-                          && c.kind != CXCursor_MemberRef
-                          && c.kind != CXCursor_FieldDecl)
-                      || (!searcher::m_exact_match
-                          && name.find(query) != std::string_view::npos))
-                  {
-                    auto haystack_size = haystack.size();
-                    auto pos = source_range.begin_int_data - 2;
-                    auto count =
-                        source_range.end_int_data - source_range.begin_int_data;
-
-                    // fmt::print("{} - Pos: {}, Count: {}, Haystack size:
-                    // {}\n", filename, pos, count, haystack_size);
-
-                    if ((searcher::m_search_expressions
-                         && (c.kind == CXCursor_DeclRefExpr
-                             || c.kind == CXCursor_MemberRefExpr
-                             || c.kind == CXCursor_MemberRef
-                             || c.kind == CXCursor_FieldDecl)))
-                    {
-                      // Update pos and count so that the entire line of code is
-                      // printed instead of just the reference (e.g., variable
-                      // name)
-                      auto newline_before = haystack.rfind('\n', pos);
-                      while (haystack[newline_before + 1] == ' '
-                             || haystack[newline_before + 1] == '\t')
-                      {
-                        newline_before += 1;
-                      }
-                      auto newline_after = haystack.find('\n', pos);
-                      pos = newline_before + 1;
-                      count = newline_after - newline_before - 1;
-                    }
-
-                    if (pos < haystack_size) {
-                      auto code_snippet = haystack.substr(pos, count);
-
-                      // Handles throw expression, static_cast,
-                      // dynamic_cast, const_cast, reinterpret_cast
-                      // for_statement, and ranged_for_statement
-                      //
-                      // if the `query` is part of the code snippet,
-                      // then show result, else, skip it
-                      if (searcher::m_search_for_throw_expression
-                          || searcher::m_search_for_typedef
-                          || searcher::m_search_for_static_cast
-                          || searcher::m_search_for_dynamic_cast
-                          || searcher::m_search_for_reinterpret_cast
-                          || searcher::m_search_for_const_cast
-                          || searcher::m_search_for_for_statement)
-                      {
-                        if (code_snippet.find(query) == std::string_view::npos)
-                        {
-                          // skip result
-                          return CXChildVisit_Continue;
-                        }
-                      }
-                      if (printer) {
-                        printer(filename,
-                                m_is_stdout,
-                                start_line,
-                                end_line,
-                                code_snippet);
-                      } else {
-                        print_code_snippet(filename,
-                                       m_is_stdout,
-                                       start_line,
-                                       end_line,
-                                       code_snippet);
-                      }
-
-                      // Line number (start, end)
-                    }
-                  }
-                }
-              }
-              return CXChildVisit_Recurse;
-            },
-            (void*)(&args)))
+  const auto& p = plan();
+  query_list found;
+  if (!haystack.empty()) {
+    found = p.unconditional;
+    find_literals(p.literals, haystack, padding, found);
+    find_literals(p.ignore_case_literals, haystack, padding, found);
+    // A query can have several literals in the file
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+  }
+
+  stats::add(found.empty() ? counter::prefilter_misses
+                           : counter::prefilter_hits);
+  return found;
+}
+
+void searcher::file_search(std::string_view filename,
+                           std::string_view haystack,
+                           std::size_t padding)
+{
+  const auto queries = prefilter(filename, haystack, padding);
+  if (!queries.empty()) {
+    // analyze file
+    parse_and_search(filename, haystack, queries, nullptr);
+  }
+}
+
+// A counting semaphore (std::counting_semaphore is C++20)
+class semaphore
+{
+public:
+  explicit semaphore(std::size_t count)
+      : m_count(count)
+  {
+  }
+
+  void acquire()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_available.wait(lock, [this] { return m_count > 0; });
+    --m_count;
+  }
+
+  void release()
+  {
     {
-      fmt::print("Error: Visit children failed for {}\n)", path);
+      const std::scoped_lock lock(m_mutex);
+      ++m_count;
     }
+    m_available.notify_one();
+  }
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_available;
+  std::size_t m_count;
+};
+
+// Files that passed the prefilter, waiting for or being parsed. Bounds
+// how far the scan stage can run ahead of libclang, and with it how many
+// file buffers are held at once.
+semaphore& parse_slots()
+{
+  static semaphore slots(searcher::m_parse_queue_size);
+  return slots;
+}
 
-    clang_disposeTranslationUnit(unit);
-    clang_disposeIndex(index);
+// Hands `task` to the parse stage. Blocks while the stage is full.
+template<typename F>
+void queue_parse(const F& task)
+{
+  if (is_cancelled()) {
+    return;
+  }
+  {
+    const phase_timer timer(phase::parse_queue);
+    parse_slots().acquire();
   }
+  searcher::m_parse_pool->push_task(
+      [task]()
+      {
+        if (!is_cancelled()) {
+          task();
+        }
+        parse_slots().release();
+      });
 }
 
-std::string get_file_contents(const char* filename)
+// Answers from the declaration index if it has an up to date entry for
+// the file, otherwise parses the file and records its cursors
+void indexed_search(const char* path)
 {
-  std::FILE* fp = std::fopen(filename, "rb");
-  if (fp) {
-    std::string contents;
-    std::fseek(fp, 0, SEEK_END);
-    contents.resize(std::ftell(fp));
-    std::rewind(fp);
-    const auto size = std::fread(&contents[0], 1, contents.size(), fp);
-    std::fclose(fp);
-    return (contents);
+  file_stamp stamp;
+  if (!get_file_stamp(path, stamp)) {
+    return;
+  }
+  const auto key = fs::absolute(fs::path(path)).lexically_normal().string();
+
+  // The file is only read if some cursor could be reported
+  file_contents haystack;
+  bool loaded = false;
+  file_results results(path);
+  const bool indexed = searcher::m_index.for_each_cursor(
+      key,
+      stamp,
+      [&](const indexed_cursor& cursor)
+      {
+        for (const auto i : plan().all) {
+          const auto& q = searcher::m_queries[i];
+          if (!is_searched_by(i, cursor.kind) || !matches_query(q, cursor)) {
+            continue;
+          }
+          if (!loaded) {
+            haystack = read_file(path);
+            loaded = true;
+          }
+          report_cursor(q, cursor, haystack.view(), results);
+        }
+      });
+  finish_file(std::move(results));
+
+  if (!indexed) {
+    queue_parse(
+        [path = std::string {path}, key, stamp]()
+        {
+          const file_contents contents = read_file(path.c_str());
+          cursor_collector collector;
+          if (parse_and_search(
+                  path, contents.view(), plan().all, &collector))
+          {
+            searcher::m_index.update(key, stamp, collector.cursors);
+          }
+        });
   }
-  return "";
 }
 
 void searcher::read_file_and_search(const char* path)
 {
-  const std::string haystack = get_file_contents(path);
-  file_search(path, haystack);
+  if (is_cancelled()) {
+    return;
+  }
+  if (m_index.is_open()) {
+    indexed_search(path);
+    return;
+  }
+  auto haystack = std::make_shared<file_contents>(read_file(path));
+  auto queries = prefilter(path, haystack->view(), file_contents::padding);
+  if (!queries.empty()) {
+    queue_parse(
+        [path = std::string {path}, haystack, queries = std::move(queries)]()
+        { parse_and_search(path, haystack->view(), queries, nullptr); });
+  }
+}
+
+void searcher::read_files_and_search(const std::vector<std::string>& paths)
+{
+  if (is_cancelled()) {
+    return;
+  }
+  // The prefilter and parse queue timers in the callback pause this one
+  const phase_timer timer(phase::read);
+  read_files(
+      paths,
+      [](const std::string& path, file_contents contents)
+      {
+        if (is_cancelled()) {
+          return;
+        }
+        auto queries =
+            prefilter(path, contents.view(), file_contents::padding);
+        if (queries.empty()) {
+          return;
+        }
+        // This worker goes straight back to the batch's reads
+        auto shared = std::make_shared<file_contents>(std::move(contents));
+        queue_parse(
+            [path, shared, queries = std::move(queries)]()
+            { parse_and_search(path, shared->view(), queries, nullptr); });
+      });
 }
 
 bool is_whitelisted(const std::string_view& str)
@@ -416,30 +1033,245 @@ bool is_whitelisted(const std::string_view& str)
   return result;
 }
 
-void searcher::directory_search(const char* search_path)
+bool is_candidate_file(const std::string& path)
 {
-  static const bool skip_fnmatch =
+  static const bool skip_filter =
       searcher::m_filter == std::string_view {"*.*"};
+  static const glob filter {searcher::m_filter};
 
-  for (auto const& dir_entry : fs::recursive_directory_iterator(search_path)) {
-    const auto& path = dir_entry.path();
-    const char* path_string = path.c_str();
-    if ((searcher::m_no_ignore_dirs || !exclude_directory(path_string)) && fs::is_regular_file(path)) {
-      bool consider_file = false;
-      if ((skip_fnmatch && is_whitelisted(path_string))
-          || (!skip_fnmatch
-              && fnmatch(searcher::m_filter.data(), path_string, 0) == 0))
-      {
-        consider_file = true;
+  return (skip_filter && is_whitelisted(path))
+      || (!skip_filter && filter.matches(path));
+}
+
+// Files are read in batches through io_uring when possible. The index
+// reads files lazily, so it keeps the one task per file path.
+bool batch_file_reads()
+{
+  static const bool batch = searcher::m_use_io_uring
+      && !searcher::m_index.is_open() && io_uring_available();
+  return batch;
+}
+
+void search_files(std::vector<std::string>&& paths)
+{
+  searcher::m_ts->push_task([paths = std::move(paths)]()
+                            { searcher::read_files_and_search(paths); });
+}
+
+struct directory_entry
+{
+  std::string path;
+  std::size_t name_offset;
+  unsigned char type;
+
+  std::string_view name() const
+  {
+    return std::string_view {path}.substr(name_offset);
+  }
+};
+
+// Reads the .gitignore/.ignore files of a directory, if it has any, on
+// top of the rules inherited from its parent
+std::shared_ptr<const ignore_context> directory_ignore_context(
+    const std::string& path,
+    std::shared_ptr<const ignore_context> parent,
+    bool has_git,
+    bool has_gitignore,
+    bool has_ignore)
+{
+  const bool in_git_repo = has_git || (parent && parent->in_git_repo);
+  if (!has_git && !(has_gitignore && in_git_repo) && !has_ignore) {
+    return parent;
+  }
+
+  const bool needs_separator = path.empty() || path.back() != '/';
+  const auto file_path = [&](const char* name)
+  { return needs_separator ? path + '/' + name : path + name; };
+
+  auto context = std::make_shared<ignore_context>();
+  context->base = path;
+  context->in_git_repo = in_git_repo;
+  if (has_git) {
+    // The repository's own excludes, below its .gitignore
+    auto exclude = std::make_shared<ignore_context>(*context);
+    exclude->parent = std::move(parent);
+    exclude->rules.add_file(file_path(".git/info/exclude"));
+    parent = std::move(exclude);
+  }
+  context->parent = std::move(parent);
+  if (has_gitignore && in_git_repo) {
+    context->rules.add_file(file_path(".gitignore"));
+  }
+  if (has_ignore) {
+    context->rules.add_file(file_path(".ignore"));
+  }
+  return context;
+}
+
+// Reads one directory. Subdirectories are pushed back to the thread pool,
+// so the walk is spread across all workers, and files are queued for
+// searching as soon as they are found.
+void walk_directory(const std::string& path,
+                    std::shared_ptr<const ignore_context> context)
+{
+  if (is_cancelled()) {
+    return;
+  }
+  phase_timer timer(phase::walk);
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+
+  // The whole directory is read first: its ignore files apply to every
+  // entry in it, wherever readdir happens to return them
+  std::vector<directory_entry> entries;
+  bool has_git = false;
+  bool has_gitignore = false;
+  bool has_ignore = false;
+
+  const bool needs_separator = path.empty() || path.back() != '/';
+  while (const dirent* entry = readdir(dir)) {
+    const char* name = entry->d_name;
+    if (name[0] == '.'
+        && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+    {
+      continue;
+    }
+
+    std::string child_path;
+    child_path.reserve(path.size() + 1 + std::strlen(name));
+    child_path += path;
+    if (needs_separator) {
+      child_path += '/';
+    }
+    const auto name_offset = child_path.size();
+    child_path += name;
+
+    // d_type saves a stat per entry. It is only missing on some
+    // filesystems, and symlinks are resolved like before: links to
+    // files are searched, links to directories are not followed.
+    auto type = entry->d_type;
+    if (type == DT_UNKNOWN || type == DT_LNK) {
+      struct stat st;
+      if (::lstat(child_path.c_str(), &st) != 0) {
+        continue;
+      }
+      if (S_ISLNK(st.st_mode)) {
+        type = (::stat(child_path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            ? DT_REG
+            : DT_LNK;
+      } else if (S_ISDIR(st.st_mode)) {
+        type = DT_DIR;
+      } else if (S_ISREG(st.st_mode)) {
+        type = DT_REG;
+      }
+    }
+
+    const std::string_view entry_name {name};
+    if (entry_name == ".git") {
+      // A directory, or a file in worktrees and submodules
+      has_git = true;
+    } else if (type == DT_REG && entry_name == ".gitignore") {
+      has_gitignore = true;
+    } else if (type == DT_REG && entry_name == ".ignore") {
+      has_ignore = true;
+    }
+
+    if (type == DT_DIR || type == DT_REG) {
+      entries.push_back({std::move(child_path), name_offset, type});
+    }
+  }
+  closedir(dir);
+  timer.annotate(path, entries.size());
+
+  if (!searcher::m_no_ignore_dirs) {
+    context = directory_ignore_context(
+        path, std::move(context), has_git, has_gitignore, has_ignore);
+  }
+
+  std::vector<std::string> batch;
+  for (auto& entry : entries) {
+    if (is_cancelled()) {
+      return;
+    }
+    const bool is_dir = entry.type == DT_DIR;
+    if (!is_dir) {
+      stats::add(counter::files_seen);
+    }
+    // Ignored directories are pruned here, so nothing below them is
+    // ever read
+    if (!searcher::m_no_ignore_dirs
+        && ((is_dir && searcher::is_ignored_directory(entry.name()))
+            || is_ignored(context.get(), entry.path, entry.name(), is_dir)))
+    {
+      if (!is_dir) {
+        stats::add(counter::files_excluded);
       }
-      if (consider_file) {
-        searcher::m_ts->push_task(
-            [pathstring = std::string {path_string}]()
-            { searcher::read_file_and_search(pathstring.data()); });
+      continue;
+    }
+    if (is_dir) {
+      searcher::m_ts->push_task(
+          [child_path = std::move(entry.path), context]()
+          { walk_directory(child_path, context); });
+    } else if (!is_candidate_file(entry.path)) {
+      stats::add(counter::files_excluded);
+      continue;
+    } else if (batch_file_reads()) {
+      batch.push_back(std::move(entry.path));
+      if (batch.size() == read_batch_size) {
+        search_files(std::move(batch));
+        batch = {};
       }
+    } else {
+      searcher::m_ts->push_task(
+          [path = std::move(entry.path)]()
+          { searcher::read_file_and_search(path.data()); });
     }
   }
-  searcher::m_ts->wait_for_tasks();
+  if (!batch.empty()) {
+    search_files(std::move(batch));
+  }
+}
+
+// Directories that are never descended into (VCS, IDE, common build
+// directories, etc.), matched against the directory name
+bool searcher::is_ignored_directory(std::string_view name)
+{
+  static const std::unordered_set<std::string_view> ignored_dirs = {
+      ".git",         ".github",       "build",
+      "node_modules", ".vscode",       ".DS_Store",
+      "debugPublic",  "DebugPublic",   "debug",
+      "Debug",        "Release",       "release",
+      "Releases",     "releases",      "cmake-build-debug",
+      "__pycache__",  "Binaries",      "Doc",
+      "doc",          "Documentation", "docs",
+      "Docs",         "bin",           "Bin",
+      "patches",      "tar-install",   "CMakeFiles",
+      "install",      "snap",          "LICENSES",
+      "img",          "images",        "imgs",
+      ".cache"};
+
+  return ignored_dirs.count(name) != 0 || m_ignored_dirs.count(name) != 0;
+}
+
+void searcher::directory_search(const char* search_path)
+{
+  std::shared_ptr<const ignore_context> context;
+  if (!searcher::m_no_ignore_dirs) {
+    context = root_ignore_context(search_path);
+  }
+  searcher::m_ts->push_task(
+      [path = std::string {search_path}, context = std::move(context)]()
+      { walk_directory(path, context); });
+  wait_for_tasks();
+}
+
+void searcher::wait_for_tasks()
+{
+  // Nothing is queued for parsing once the scan stage is done
+  m_ts->wait_for_tasks();
+  m_parse_pool->wait_for_tasks();
 }
 
 }  // namespace search
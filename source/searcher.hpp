@@ -1,5 +1,6 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <chrono>
@@ -18,58 +19,118 @@
 #define FMT_HEADER_ONLY 1
 #include <fmt/color.h>
 #include <fmt/core.h>
-#if defined(__x86_64__) || defined (__i686__)
+#if defined(__x86_64__) || defined(__i386__)
 #include <immintrin.h>
 #endif
+#include <compilation_database.hpp>
+#include <declaration_index.hpp>
+#include <file_contents.hpp>
+#include <io_uring_reader.hpp>
+#include <match_counts.hpp>
+#include <regex.hpp>
+#include <result_sink.hpp>
 #include <sse2_strstr.hpp>
-#include <thread_pool.hpp>
+#include <work_stealing_pool.hpp>
 
 namespace search
 {
+// Formats one result into `out`, the buffer of the file's results.
+// `query_id` is the id of the query it matched.
 using custom_printer_callback =
-    std::function<void(std::string_view filename,
+    std::function<void(fmt::memory_buffer& out,
+                       std::string_view filename,
                        bool is_stdout,
                        unsigned start_line,
                        unsigned end_line,
-                       std::string_view code_snippet)>;
+                       std::string_view code_snippet,
+                       std::size_t query_id)>;
+
+// What to search for: the name or code to look for, and the kinds of
+// cursors to look at
+struct query
+{
+  // The position of the query in the --queries-from file, starting at 1;
+  // 0 for the query given on the command line
+  std::size_t id {0};
+  std::string text;
+  bool exact_match {false};
+  // --ignore-case: ASCII letters match in either case
+  bool ignore_case {false};
+  // --regex: `text` compiled, and for exact matches, anchored at both
+  // ends
+  std::shared_ptr<const regex> pattern;
+  std::shared_ptr<const regex> exact_pattern;
+  bool search_for_enum {false};
+  bool search_for_struct {false};
+  bool search_for_union {false};
+  bool search_for_member_function {false};
+  bool search_for_function {false};
+  bool search_for_function_template {false};
+  bool search_for_class {false};
+  bool search_for_class_template {false};
+  bool search_for_class_constructor {false};
+  bool search_for_class_destructor {false};
+  bool search_for_typedef {false};
+  bool search_for_using_declaration {false};
+  bool search_for_namespace_alias {false};
+  bool search_expressions {false};
+  bool search_for_variable_declaration {false};
+  bool search_for_parameter_declaration {false};
+  bool search_for_static_cast {false};
+  bool search_for_dynamic_cast {false};
+  bool search_for_reinterpret_cast {false};
+  bool search_for_const_cast {false};
+  bool search_for_throw_expression {false};
+  bool search_for_for_statement {false};
+};
+
 struct searcher
 {
-  static inline std::unique_ptr<thread_pool> m_ts;
-  static inline std::string_view m_query;
+  // The scan stage (walking, reading and prefiltering) and the parse
+  // stage, which runs at most m_parse_queue_size files ahead of it
+  static inline std::unique_ptr<work_stealing_pool> m_ts;
+  static inline std::unique_ptr<work_stealing_pool> m_parse_pool;
+  static inline std::size_t m_parse_queue_size;
+  // Usually a single query. Every file is read, prefiltered, parsed and
+  // visited once, whatever the number of queries.
+  static inline std::vector<query> m_queries;
   static inline std::string_view m_filter;
   static inline bool m_no_ignore_dirs;
+  static inline std::unordered_set<std::string_view> m_ignored_dirs;
   static inline bool m_verbose;
   static inline bool m_is_stdout;
   static inline std::vector<const char*> m_clang_options;
-  static inline bool m_exact_match;
-  static inline bool m_search_for_enum;
-  static inline bool m_search_for_struct;
-  static inline bool m_search_for_union;
-  static inline bool m_search_for_member_function;
-  static inline bool m_search_for_function;
-  static inline bool m_search_for_function_template;
-  static inline bool m_search_for_class;
-  static inline bool m_search_for_class_template;
-  static inline bool m_search_for_class_constructor;
-  static inline bool m_search_for_class_destructor;
-  static inline bool m_search_for_typedef;
-  static inline bool m_search_for_using_declaration;
-  static inline bool m_search_for_namespace_alias;
+  static inline compilation_database m_compilation_database;
+  static inline declaration_index m_index;
+  static inline bool m_use_io_uring;
   static inline bool m_ignore_single_line_results;
-  static inline bool m_search_expressions;
-  static inline bool m_search_for_variable_declaration;
-  static inline bool m_search_for_parameter_declaration;
-  static inline bool m_search_for_static_cast;
-  static inline bool m_search_for_dynamic_cast;
-  static inline bool m_search_for_reinterpret_cast;
-  static inline bool m_search_for_const_cast;
-  static inline bool m_search_for_throw_expression;
-  static inline bool m_search_for_for_statement;
+  static inline bool m_main_file_only;
   static inline custom_printer_callback m_custom_printer;
+  static inline result_sink m_results;
+  // At most this many results are reported, 0 for no limit
+  static inline std::size_t m_max_results;
+  // Report each matching file once, by name, and stop parsing it there
+  static inline bool m_files_with_matches;
+  // Set once m_max_results is reached. Queued walks, reads and parses
+  // check it and return without doing anything.
+  static inline std::atomic<bool> m_cancelled {false};
+  // --count and --count-by-kind: results are only counted, never
+  // formatted
+  static inline bool m_count_only;
+  static inline match_counts m_counts;
 
-  static void file_search(std::string_view filename, std::string_view haystack);
+  // `padding` is the number of readable bytes after the haystack, see
+  // file_contents
+  static void file_search(std::string_view filename,
+                          std::string_view haystack,
+                          std::size_t padding = 0);
   static void read_file_and_search(const char* path);
+  static void read_files_and_search(const std::vector<std::string>& paths);
   static void directory_search(const char* path);
+  // Directories that are never descended into: the built-in list
+  // and --exclude-dir
+  static bool is_ignored_directory(std::string_view name);
+  static void wait_for_tasks();
 };
 
 }  // namespace search
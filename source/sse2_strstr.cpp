@@ -2,7 +2,7 @@
 #include <cstring>
 
 #include <ctype.h>
-#if defined(__x86_64__) || defined (__i686__)
+#if defined(__x86_64__) || defined(__i386__)
 #include <immintrin.h>
 #endif
 #include <sse2_strstr.hpp>
@@ -15,6 +15,19 @@ namespace search
 {
 namespace
 {
+// memcmp5 and memcmp6 load 8 bytes, up to 2 past the end of the needle
+constexpr size_t memcmp_overread = 2;
+
+// An unaligned load. memcpy compiles to a single mov, without the
+// undefined behavior of dereferencing a misaligned pointer.
+template<typename T>
+T load(const char* p)
+{
+  T value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
 bool always_true(const char*, const char*)
 {
   return true;
@@ -27,84 +40,84 @@ bool memcmp1(const char* a, const char* b)
 
 bool memcmp2(const char* a, const char* b)
 {
-  const uint16_t A = *reinterpret_cast<const uint16_t*>(a);
-  const uint16_t B = *reinterpret_cast<const uint16_t*>(b);
+  const uint16_t A = load<uint16_t>(a);
+  const uint16_t B = load<uint16_t>(b);
   return A == B;
 }
 
 bool memcmp3(const char* a, const char* b)
 {
-  const uint32_t A = *reinterpret_cast<const uint32_t*>(a);
-  const uint32_t B = *reinterpret_cast<const uint32_t*>(b);
+  const uint32_t A = load<uint32_t>(a);
+  const uint32_t B = load<uint32_t>(b);
   return (A & 0x00ffffff) == (B & 0x00ffffff);
 }
 
 bool memcmp4(const char* a, const char* b)
 {
-  const uint32_t A = *reinterpret_cast<const uint32_t*>(a);
-  const uint32_t B = *reinterpret_cast<const uint32_t*>(b);
+  const uint32_t A = load<uint32_t>(a);
+  const uint32_t B = load<uint32_t>(b);
   return A == B;
 }
 
 bool memcmp5(const char* a, const char* b)
 {
-  const uint64_t A = *reinterpret_cast<const uint64_t*>(a);
-  const uint64_t B = *reinterpret_cast<const uint64_t*>(b);
+  const uint64_t A = load<uint64_t>(a);
+  const uint64_t B = load<uint64_t>(b);
   return ((A ^ B) & 0x000000fffffffffflu) == 0;
 }
 
 bool memcmp6(const char* a, const char* b)
 {
-  const uint64_t A = *reinterpret_cast<const uint64_t*>(a);
-  const uint64_t B = *reinterpret_cast<const uint64_t*>(b);
+  const uint64_t A = load<uint64_t>(a);
+  const uint64_t B = load<uint64_t>(b);
   return ((A ^ B) & 0x0000fffffffffffflu) == 0;
 }
 
 bool memcmp7(const char* a, const char* b)
 {
-  const uint64_t A = *reinterpret_cast<const uint64_t*>(a);
-  const uint64_t B = *reinterpret_cast<const uint64_t*>(b);
+  const uint64_t A = load<uint64_t>(a);
+  const uint64_t B = load<uint64_t>(b);
   return ((A ^ B) & 0x00fffffffffffffflu) == 0;
 }
 
 bool memcmp8(const char* a, const char* b)
 {
-  const uint64_t A = *reinterpret_cast<const uint64_t*>(a);
-  const uint64_t B = *reinterpret_cast<const uint64_t*>(b);
+  const uint64_t A = load<uint64_t>(a);
+  const uint64_t B = load<uint64_t>(b);
   return A == B;
 }
 
 bool memcmp9(const char* a, const char* b)
 {
-  const uint64_t A = *reinterpret_cast<const uint64_t*>(a);
-  const uint64_t B = *reinterpret_cast<const uint64_t*>(b);
+  const uint64_t A = load<uint64_t>(a);
+  const uint64_t B = load<uint64_t>(b);
   return (A == B) & (a[8] == b[8]);
 }
 
 bool memcmp10(const char* a, const char* b)
 {
-  const uint64_t Aq = *reinterpret_cast<const uint64_t*>(a);
-  const uint64_t Bq = *reinterpret_cast<const uint64_t*>(b);
-  const uint16_t Aw = *reinterpret_cast<const uint16_t*>(a + 8);
-  const uint16_t Bw = *reinterpret_cast<const uint16_t*>(b + 8);
+  const uint64_t Aq = load<uint64_t>(a);
+  const uint64_t Bq = load<uint64_t>(b);
+  const uint16_t Aw = load<uint16_t>(a + 8);
+  const uint16_t Bw = load<uint16_t>(b + 8);
   return (Aq == Bq) & (Aw == Bw);
 }
 
 bool memcmp11(const char* a, const char* b)
 {
-  const uint64_t Aq = *reinterpret_cast<const uint64_t*>(a);
-  const uint64_t Bq = *reinterpret_cast<const uint64_t*>(b);
-  const uint32_t Ad = *reinterpret_cast<const uint32_t*>(a + 8);
-  const uint32_t Bd = *reinterpret_cast<const uint32_t*>(b + 8);
+  const uint64_t Aq = load<uint64_t>(a);
+  const uint64_t Bq = load<uint64_t>(b);
+  const uint32_t Ad = load<uint32_t>(a + 8);
+  const uint32_t Bd = load<uint32_t>(b + 8);
   return (Aq == Bq) & ((Ad & 0x00ffffff) == (Bd & 0x00ffffff));
 }
 
 bool memcmp12(const char* a, const char* b)
 {
-  const uint64_t Aq = *reinterpret_cast<const uint64_t*>(a);
-  const uint64_t Bq = *reinterpret_cast<const uint64_t*>(b);
-  const uint32_t Ad = *reinterpret_cast<const uint32_t*>(a + 8);
-  const uint32_t Bd = *reinterpret_cast<const uint32_t*>(b + 8);
+  const uint64_t Aq = load<uint64_t>(a);
+  const uint64_t Bq = load<uint64_t>(b);
+  const uint32_t Ad = load<uint32_t>(a + 8);
+  const uint32_t Bd = load<uint32_t>(b + 8);
   return (Aq == Bq) & (Ad == Bd);
 }
 
@@ -125,7 +138,7 @@ unsigned get_first_bit_set(const T value)
 {
   assert(value != 0);
 
-  return __builtin_ctz(value);
+  return static_cast<unsigned>(__builtin_ctz(value));
 }
 
 template<>
@@ -133,13 +146,31 @@ unsigned get_first_bit_set<uint64_t>(const uint64_t value)
 {
   assert(value != 0);
 
-  return __builtin_ctzl(value);
+  return static_cast<unsigned>(__builtin_ctzl(value));
 }
 
 }  // namespace bits
 
+// Checks the positions from `i` on whose blocks would be loaded past the
+// readable bytes
+size_t FORCE_INLINE scalar_strstr(const char* s,
+                                  size_t n,
+                                  size_t i,
+                                  const char* needle,
+                                  size_t k)
+{
+  for (; i + k <= n; ++i) {
+    if (s[i] == needle[0] && memcmp(s + i + 1, needle + 1, k - 1) == 0) {
+      return i;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
 size_t FORCE_INLINE sse2_strstr_anysize(const char* s,
                                         size_t n,
+                                        size_t padding,
                                         const char* needle,
                                         size_t k)
 {
@@ -149,7 +180,8 @@ size_t FORCE_INLINE sse2_strstr_anysize(const char* s,
   const __m128i first = _mm_set1_epi8(needle[0]);
   const __m128i last = _mm_set1_epi8(needle[k - 1]);
 
-  for (size_t i = 0; i < n; i += 16) {
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 16 <= n + padding; i += 16) {
     const __m128i block_first =
         _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
     const __m128i block_last =
@@ -158,7 +190,8 @@ size_t FORCE_INLINE sse2_strstr_anysize(const char* s,
     const __m128i eq_first = _mm_cmpeq_epi8(first, block_first);
     const __m128i eq_last = _mm_cmpeq_epi8(last, block_last);
 
-    uint16_t mask = _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last));
+    uint16_t mask = static_cast<uint16_t>(
+        _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)));
 
     while (mask != 0) {
       const auto bitpos = bits::get_first_bit_set(mask);
@@ -171,7 +204,7 @@ size_t FORCE_INLINE sse2_strstr_anysize(const char* s,
     }
   }
 
-  return std::string_view::npos;
+  return scalar_strstr(s, n, i, needle, k);
 }
 
 // ------------------------------------------------------------------------
@@ -179,6 +212,7 @@ size_t FORCE_INLINE sse2_strstr_anysize(const char* s,
 template<size_t k, typename MEMCMP>
 size_t FORCE_INLINE sse2_strstr_memcmp(const char* s,
                                        size_t n,
+                                       size_t padding,
                                        const char* needle,
                                        MEMCMP memcmp_fun)
 {
@@ -188,7 +222,8 @@ size_t FORCE_INLINE sse2_strstr_memcmp(const char* s,
   const __m128i first = _mm_set1_epi8(needle[0]);
   const __m128i last = _mm_set1_epi8(needle[k - 1]);
 
-  for (size_t i = 0; i < n; i += 16) {
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 16 + memcmp_overread <= n + padding; i += 16) {
     const __m128i block_first =
         _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
     const __m128i block_last =
@@ -197,7 +232,8 @@ size_t FORCE_INLINE sse2_strstr_memcmp(const char* s,
     const __m128i eq_first = _mm_cmpeq_epi8(first, block_first);
     const __m128i eq_last = _mm_cmpeq_epi8(last, block_last);
 
-    uint32_t mask = _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last));
+    uint32_t mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)));
 
     while (mask != 0) {
       const auto bitpos = bits::get_first_bit_set(mask);
@@ -210,12 +246,528 @@ size_t FORCE_INLINE sse2_strstr_memcmp(const char* s,
     }
   }
 
+  return scalar_strstr(s, n, i, needle, k);
+}
+
+// ------------------------------------------------------------------------
+
+// The case-insensitive kernels fold ASCII letters in the registers: the
+// haystack is never copied or lowercased up front. Blocks are compared
+// against both cases of the needle's first and last bytes, and each
+// candidate is verified 16 bytes at a time, folding both sides.
+
+char FORCE_INLINE ascii_to_lower(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+char FORCE_INLINE ascii_to_upper(char c)
+{
+  return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+}
+
+// Lowercases the ASCII letters of a block. Adding 128 - 'A' moves 'A'..'Z'
+// to the 26 smallest signed bytes, so a single signed compare finds them.
+__m128i FORCE_INLINE sse2_to_lower(__m128i block)
+{
+  const __m128i shifted =
+      _mm_add_epi8(block, _mm_set1_epi8(static_cast<char>(128 - 'A')));
+  const __m128i is_upper =
+      _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + 26)));
+  return _mm_or_si128(block, _mm_and_si128(is_upper, _mm_set1_epi8(0x20)));
+}
+
+bool FORCE_INLINE equal_ignore_case(const char* a, const char* b, size_t k)
+{
+  size_t i = 0;
+  for (; i + 16 <= k; i += 16) {
+    const __m128i block_a =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i block_b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    const __m128i eq =
+        _mm_cmpeq_epi8(sse2_to_lower(block_a), sse2_to_lower(block_b));
+    if (_mm_movemask_epi8(eq) != 0xffff) {
+      return false;
+    }
+  }
+  for (; i < k; ++i) {
+    if (ascii_to_lower(a[i]) != ascii_to_lower(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The bytes between the first and the last, which the block compares
+// have already matched
+bool FORCE_INLINE middle_equal_ignore_case(const char* s,
+                                           const char* needle,
+                                           size_t k)
+{
+  return k <= 2 || equal_ignore_case(s + 1, needle + 1, k - 2);
+}
+
+size_t FORCE_INLINE scalar_strcasestr(const char* s,
+                                      size_t n,
+                                      size_t i,
+                                      const char* needle,
+                                      size_t k)
+{
+  for (; i + k <= n; ++i) {
+    if (equal_ignore_case(s + i, needle, k)) {
+      return i;
+    }
+  }
+
   return std::string_view::npos;
 }
 
+size_t FORCE_INLINE sse2_strcasestr_anysize(const char* s,
+                                            size_t n,
+                                            size_t padding,
+                                            const char* needle,
+                                            size_t k)
+{
+  assert(k > 0);
+  assert(n > 0);
+
+  const __m128i first_lower = _mm_set1_epi8(ascii_to_lower(needle[0]));
+  const __m128i first_upper = _mm_set1_epi8(ascii_to_upper(needle[0]));
+  const __m128i last_lower = _mm_set1_epi8(ascii_to_lower(needle[k - 1]));
+  const __m128i last_upper = _mm_set1_epi8(ascii_to_upper(needle[k - 1]));
+
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 16 <= n + padding; i += 16) {
+    const __m128i block_first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    const __m128i block_last =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + k - 1));
+
+    const __m128i eq_first =
+        _mm_or_si128(_mm_cmpeq_epi8(first_lower, block_first),
+                     _mm_cmpeq_epi8(first_upper, block_first));
+    const __m128i eq_last =
+        _mm_or_si128(_mm_cmpeq_epi8(last_lower, block_last),
+                     _mm_cmpeq_epi8(last_upper, block_last));
+
+    uint16_t mask = static_cast<uint16_t>(
+        _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)));
+
+    while (mask != 0) {
+      const auto bitpos = bits::get_first_bit_set(mask);
+
+      if (middle_equal_ignore_case(s + i + bitpos, needle, k)) {
+        return i + bitpos;
+      }
+
+      mask = bits::clear_leftmost_set(mask);
+    }
+  }
+
+  return scalar_strcasestr(s, n, i, needle, k);
+}
+
 // ------------------------------------------------------------------------
 
-size_t sse2_strstr_v2(const char* s, size_t n, const char* needle, size_t k)
+#if defined(__x86_64__) || defined(__i386__)
+
+#  define TARGET_AVX2 __attribute__((target("avx2")))
+#  define TARGET_AVX512BW __attribute__((target("avx512f,avx512bw")))
+
+// The wide kernels only scan blocks whose loads stay inside the readable
+// bytes and hand whatever is left over to the 16-byte kernel.
+
+template<size_t k, typename MEMCMP>
+TARGET_AVX2 inline size_t avx2_strstr_memcmp(const char* s,
+                                             size_t n,
+                                             size_t padding,
+                                             const char* needle,
+                                             MEMCMP memcmp_fun)
+{
+  assert(k > 0);
+  assert(n > 0);
+
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 32 + memcmp_overread <= n + padding; i += 32) {
+    const __m256i block_first =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    const __m256i block_last =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k - 1));
+
+    const __m256i eq_first = _mm256_cmpeq_epi8(first, block_first);
+    const __m256i eq_last = _mm256_cmpeq_epi8(last, block_last);
+
+    uint32_t mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)));
+
+    while (mask != 0) {
+      const auto bitpos = bits::get_first_bit_set(mask);
+
+      if (memcmp_fun(s + i + bitpos + 1, needle + 1)) {
+        return i + bitpos;
+      }
+
+      mask = bits::clear_leftmost_set(mask);
+    }
+  }
+
+  if (i < n) {
+    const auto result = sse2_strstr_memcmp<k>(
+        s + i, n - i, padding, needle, memcmp_fun);
+    if (result != std::string_view::npos) {
+      return i + result;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+TARGET_AVX2 inline size_t avx2_strstr_anysize(const char* s,
+                                              size_t n,
+                                              size_t padding,
+                                              const char* needle,
+                                              size_t k)
+{
+  assert(k > 0);
+  assert(n > 0);
+
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 32 <= n + padding; i += 32) {
+    const __m256i block_first =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    const __m256i block_last =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k - 1));
+
+    const __m256i eq_first = _mm256_cmpeq_epi8(first, block_first);
+    const __m256i eq_last = _mm256_cmpeq_epi8(last, block_last);
+
+    uint32_t mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)));
+
+    while (mask != 0) {
+      const auto bitpos = bits::get_first_bit_set(mask);
+
+      if (memcmp(s + i + bitpos + 1, needle + 1, k - 2) == 0) {
+        return i + bitpos;
+      }
+
+      mask = bits::clear_leftmost_set(mask);
+    }
+  }
+
+  if (i < n) {
+    const auto result = sse2_strstr_anysize(s + i, n - i, padding, needle, k);
+    if (result != std::string_view::npos) {
+      return i + result;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+// ------------------------------------------------------------------------
+
+template<size_t k, typename MEMCMP>
+TARGET_AVX512BW inline size_t avx512bw_strstr_memcmp(const char* s,
+                                                     size_t n,
+                                                     size_t padding,
+                                                     const char* needle,
+                                                     MEMCMP memcmp_fun)
+{
+  assert(k > 0);
+  assert(n > 0);
+
+  const __m512i first = _mm512_set1_epi8(needle[0]);
+  const __m512i last = _mm512_set1_epi8(needle[k - 1]);
+
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 64 + memcmp_overread <= n + padding; i += 64) {
+    const __m512i block_first = _mm512_loadu_si512(s + i);
+    const __m512i block_last = _mm512_loadu_si512(s + i + k - 1);
+
+    uint64_t mask = _mm512_cmpeq_epi8_mask(first, block_first)
+        & _mm512_cmpeq_epi8_mask(last, block_last);
+
+    while (mask != 0) {
+      const auto bitpos = bits::get_first_bit_set(mask);
+
+      if (memcmp_fun(s + i + bitpos + 1, needle + 1)) {
+        return i + bitpos;
+      }
+
+      mask = bits::clear_leftmost_set(mask);
+    }
+  }
+
+  if (i < n) {
+    const auto result = sse2_strstr_memcmp<k>(
+        s + i, n - i, padding, needle, memcmp_fun);
+    if (result != std::string_view::npos) {
+      return i + result;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+TARGET_AVX512BW inline size_t avx512bw_strstr_anysize(const char* s,
+                                                      size_t n,
+                                                      size_t padding,
+                                                      const char* needle,
+                                                      size_t k)
+{
+  assert(k > 0);
+  assert(n > 0);
+
+  const __m512i first = _mm512_set1_epi8(needle[0]);
+  const __m512i last = _mm512_set1_epi8(needle[k - 1]);
+
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 64 <= n + padding; i += 64) {
+    const __m512i block_first = _mm512_loadu_si512(s + i);
+    const __m512i block_last = _mm512_loadu_si512(s + i + k - 1);
+
+    uint64_t mask = _mm512_cmpeq_epi8_mask(first, block_first)
+        & _mm512_cmpeq_epi8_mask(last, block_last);
+
+    while (mask != 0) {
+      const auto bitpos = bits::get_first_bit_set(mask);
+
+      if (memcmp(s + i + bitpos + 1, needle + 1, k - 2) == 0) {
+        return i + bitpos;
+      }
+
+      mask = bits::clear_leftmost_set(mask);
+    }
+  }
+
+  if (i < n) {
+    const auto result = sse2_strstr_anysize(s + i, n - i, padding, needle, k);
+    if (result != std::string_view::npos) {
+      return i + result;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+// ------------------------------------------------------------------------
+
+TARGET_AVX2 inline size_t avx2_strcasestr_anysize(const char* s,
+                                                  size_t n,
+                                                  size_t padding,
+                                                  const char* needle,
+                                                  size_t k)
+{
+  assert(k > 0);
+  assert(n > 0);
+
+  const __m256i first_lower = _mm256_set1_epi8(ascii_to_lower(needle[0]));
+  const __m256i first_upper = _mm256_set1_epi8(ascii_to_upper(needle[0]));
+  const __m256i last_lower = _mm256_set1_epi8(ascii_to_lower(needle[k - 1]));
+  const __m256i last_upper = _mm256_set1_epi8(ascii_to_upper(needle[k - 1]));
+
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 32 <= n + padding; i += 32) {
+    const __m256i block_first =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    const __m256i block_last =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k - 1));
+
+    const __m256i eq_first =
+        _mm256_or_si256(_mm256_cmpeq_epi8(first_lower, block_first),
+                        _mm256_cmpeq_epi8(first_upper, block_first));
+    const __m256i eq_last =
+        _mm256_or_si256(_mm256_cmpeq_epi8(last_lower, block_last),
+                        _mm256_cmpeq_epi8(last_upper, block_last));
+
+    uint32_t mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)));
+
+    while (mask != 0) {
+      const auto bitpos = bits::get_first_bit_set(mask);
+
+      if (middle_equal_ignore_case(s + i + bitpos, needle, k)) {
+        return i + bitpos;
+      }
+
+      mask = bits::clear_leftmost_set(mask);
+    }
+  }
+
+  if (i < n) {
+    const auto result =
+        sse2_strcasestr_anysize(s + i, n - i, padding, needle, k);
+    if (result != std::string_view::npos) {
+      return i + result;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+TARGET_AVX512BW inline size_t avx512bw_strcasestr_anysize(const char* s,
+                                                          size_t n,
+                                                          size_t padding,
+                                                          const char* needle,
+                                                          size_t k)
+{
+  assert(k > 0);
+  assert(n > 0);
+
+  const __m512i first_lower = _mm512_set1_epi8(ascii_to_lower(needle[0]));
+  const __m512i first_upper = _mm512_set1_epi8(ascii_to_upper(needle[0]));
+  const __m512i last_lower = _mm512_set1_epi8(ascii_to_lower(needle[k - 1]));
+  const __m512i last_upper = _mm512_set1_epi8(ascii_to_upper(needle[k - 1]));
+
+  size_t i = 0;
+  for (; i < n && i + k - 1 + 64 <= n + padding; i += 64) {
+    const __m512i block_first = _mm512_loadu_si512(s + i);
+    const __m512i block_last = _mm512_loadu_si512(s + i + k - 1);
+
+    uint64_t mask = (_mm512_cmpeq_epi8_mask(first_lower, block_first)
+                     | _mm512_cmpeq_epi8_mask(first_upper, block_first))
+        & (_mm512_cmpeq_epi8_mask(last_lower, block_last)
+           | _mm512_cmpeq_epi8_mask(last_upper, block_last));
+
+    while (mask != 0) {
+      const auto bitpos = bits::get_first_bit_set(mask);
+
+      if (middle_equal_ignore_case(s + i + bitpos, needle, k)) {
+        return i + bitpos;
+      }
+
+      mask = bits::clear_leftmost_set(mask);
+    }
+  }
+
+  if (i < n) {
+    const auto result =
+        sse2_strcasestr_anysize(s + i, n - i, padding, needle, k);
+    if (result != std::string_view::npos) {
+      return i + result;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+#endif
+
+// ------------------------------------------------------------------------
+
+namespace
+{
+struct sse2_kernel
+{
+  template<size_t k, typename MEMCMP>
+  static size_t FORCE_INLINE strstr_memcmp(const char* s,
+                                    size_t n,
+                                    size_t padding,
+                                    const char* needle,
+                                    MEMCMP memcmp_fun)
+  {
+    return sse2_strstr_memcmp<k>(s, n, padding, needle, memcmp_fun);
+  }
+
+  static size_t FORCE_INLINE strstr_anysize(const char* s,
+                                     size_t n,
+                                     size_t padding,
+                                     const char* needle,
+                                     size_t k)
+  {
+    return sse2_strstr_anysize(s, n, padding, needle, k);
+  }
+
+  static size_t FORCE_INLINE strcasestr_anysize(const char* s,
+                                                size_t n,
+                                                size_t padding,
+                                                const char* needle,
+                                                size_t k)
+  {
+    return sse2_strcasestr_anysize(s, n, padding, needle, k);
+  }
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+struct avx2_kernel
+{
+  template<size_t k, typename MEMCMP>
+  TARGET_AVX2 static size_t strstr_memcmp(const char* s,
+                                   size_t n,
+                                   size_t padding,
+                                   const char* needle,
+                                   MEMCMP memcmp_fun)
+  {
+    return avx2_strstr_memcmp<k>(s, n, padding, needle, memcmp_fun);
+  }
+
+  TARGET_AVX2 static size_t strstr_anysize(const char* s,
+                                    size_t n,
+                                    size_t padding,
+                                    const char* needle,
+                                    size_t k)
+  {
+    return avx2_strstr_anysize(s, n, padding, needle, k);
+  }
+
+  TARGET_AVX2 static size_t strcasestr_anysize(const char* s,
+                                               size_t n,
+                                               size_t padding,
+                                               const char* needle,
+                                               size_t k)
+  {
+    return avx2_strcasestr_anysize(s, n, padding, needle, k);
+  }
+};
+
+struct avx512bw_kernel
+{
+  template<size_t k, typename MEMCMP>
+  TARGET_AVX512BW static size_t strstr_memcmp(const char* s,
+                                       size_t n,
+                                       size_t padding,
+                                       const char* needle,
+                                       MEMCMP memcmp_fun)
+  {
+    return avx512bw_strstr_memcmp<k>(s, n, padding, needle, memcmp_fun);
+  }
+
+  TARGET_AVX512BW static size_t strstr_anysize(const char* s,
+                                        size_t n,
+                                        size_t padding,
+                                        const char* needle,
+                                        size_t k)
+  {
+    return avx512bw_strstr_anysize(s, n, padding, needle, k);
+  }
+
+  TARGET_AVX512BW static size_t strcasestr_anysize(const char* s,
+                                                   size_t n,
+                                                   size_t padding,
+                                                   const char* needle,
+                                                   size_t k)
+  {
+    return avx512bw_strcasestr_anysize(s, n, padding, needle, k);
+  }
+};
+#endif
+
+// Picks the specialization for the needle length; `Kernel` decides how
+// wide each step over the haystack is.
+template<typename Kernel>
+size_t FORCE_INLINE strstr_v2(const char* s,
+                              size_t n,
+                              size_t padding,
+                              const char* needle,
+                              size_t k)
 {
   size_t result = std::string_view::npos;
 
@@ -228,57 +780,72 @@ size_t sse2_strstr_v2(const char* s, size_t n, const char* needle, size_t k)
       return 0;
 
     case 1: {
-      const char* res = reinterpret_cast<const char*>(strchr(s, needle[0]));
+      // Bounded by n: the haystack is not NUL-terminated, and may contain
+      // NULs
+      const char* res =
+          reinterpret_cast<const char*>(std::memchr(s, needle[0], n));
 
-      return (res != nullptr) ? res - s : std::string_view::npos;
+      return (res != nullptr) ? static_cast<size_t>(res - s)
+                              : std::string_view::npos;
     }
 
     case 2:
-      result = sse2_strstr_memcmp<2>(s, n, needle, always_true);
+      result = Kernel::template strstr_memcmp<2>(
+          s, n, padding, needle, always_true);
       break;
 
     case 3:
-      result = sse2_strstr_memcmp<3>(s, n, needle, memcmp1);
+      result = Kernel::template strstr_memcmp<3>(
+          s, n, padding, needle, memcmp1);
       break;
 
     case 4:
-      result = sse2_strstr_memcmp<4>(s, n, needle, memcmp2);
+      result = Kernel::template strstr_memcmp<4>(
+          s, n, padding, needle, memcmp2);
       break;
 
     case 5:
-      result = sse2_strstr_memcmp<5>(s, n, needle, memcmp4);
+      result = Kernel::template strstr_memcmp<5>(
+          s, n, padding, needle, memcmp4);
       break;
 
     case 6:
-      result = sse2_strstr_memcmp<6>(s, n, needle, memcmp4);
+      result = Kernel::template strstr_memcmp<6>(
+          s, n, padding, needle, memcmp4);
       break;
 
     case 7:
-      result = sse2_strstr_memcmp<7>(s, n, needle, memcmp5);
+      result = Kernel::template strstr_memcmp<7>(
+          s, n, padding, needle, memcmp5);
       break;
 
     case 8:
-      result = sse2_strstr_memcmp<8>(s, n, needle, memcmp6);
+      result = Kernel::template strstr_memcmp<8>(
+          s, n, padding, needle, memcmp6);
       break;
 
     case 9:
-      result = sse2_strstr_memcmp<9>(s, n, needle, memcmp8);
+      result = Kernel::template strstr_memcmp<9>(
+          s, n, padding, needle, memcmp8);
       break;
 
     case 10:
-      result = sse2_strstr_memcmp<10>(s, n, needle, memcmp8);
+      result = Kernel::template strstr_memcmp<10>(
+          s, n, padding, needle, memcmp8);
       break;
 
     case 11:
-      result = sse2_strstr_memcmp<11>(s, n, needle, memcmp9);
+      result = Kernel::template strstr_memcmp<11>(
+          s, n, padding, needle, memcmp9);
       break;
 
     case 12:
-      result = sse2_strstr_memcmp<12>(s, n, needle, memcmp10);
+      result = Kernel::template strstr_memcmp<12>(
+          s, n, padding, needle, memcmp10);
       break;
 
     default:
-      result = sse2_strstr_anysize(s, n, needle, k);
+      result = Kernel::strstr_anysize(s, n, padding, needle, k);
       break;
   }
 
@@ -289,11 +856,198 @@ size_t sse2_strstr_v2(const char* s, size_t n, const char* needle, size_t k)
   }
 }
 
+// There are no specializations by needle length: the verification folds
+// the candidates a block at a time whatever their length.
+template<typename Kernel>
+size_t FORCE_INLINE strcasestr_v2(const char* s,
+                                  size_t n,
+                                  size_t padding,
+                                  const char* needle,
+                                  size_t k)
+{
+  if (k == 0) {
+    return 0;
+  }
+  if (n < k) {
+    return std::string_view::npos;
+  }
+
+  const auto result = Kernel::strcasestr_anysize(s, n, padding, needle, k);
+  if (result <= n - k) {
+    return result;
+  } else {
+    return std::string_view::npos;
+  }
+}
+
+}  // namespace
+
+// ------------------------------------------------------------------------
+
+size_t sse2_strstr_v2(const char* s,
+                      size_t n,
+                      size_t padding,
+                      const char* needle,
+                      size_t k)
+{
+  return strstr_v2<sse2_kernel>(s, n, padding, needle, k);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+TARGET_AVX2 size_t avx2_strstr_v2(const char* s,
+                                  size_t n,
+                                  size_t padding,
+                                  const char* needle,
+                                  size_t k)
+{
+  return strstr_v2<avx2_kernel>(s, n, padding, needle, k);
+}
+
+TARGET_AVX512BW size_t avx512bw_strstr_v2(const char* s,
+                                          size_t n,
+                                          size_t padding,
+                                          const char* needle,
+                                          size_t k)
+{
+  return strstr_v2<avx512bw_kernel>(s, n, padding, needle, k);
+}
+#endif
+
+size_t sse2_strcasestr(const char* s,
+                       size_t n,
+                       size_t padding,
+                       const char* needle,
+                       size_t k)
+{
+  return strcasestr_v2<sse2_kernel>(s, n, padding, needle, k);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+TARGET_AVX2 size_t avx2_strcasestr(const char* s,
+                                   size_t n,
+                                   size_t padding,
+                                   const char* needle,
+                                   size_t k)
+{
+  return strcasestr_v2<avx2_kernel>(s, n, padding, needle, k);
+}
+
+TARGET_AVX512BW size_t avx512bw_strcasestr(const char* s,
+                                           size_t n,
+                                           size_t padding,
+                                           const char* needle,
+                                           size_t k)
+{
+  return strcasestr_v2<avx512bw_kernel>(s, n, padding, needle, k);
+}
+#endif
+
 // ------------------------------------------------------------------------
 
-size_t sse2_strstr_v2(const std::string_view& s, const std::string_view& needle)
+size_t sse2_strstr_v2(const std::string_view& s,
+                      const std::string_view& needle,
+                      size_t padding)
+{
+  return sse2_strstr_v2(
+      s.data(), s.size(), padding, needle.data(), needle.size());
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+size_t avx2_strstr_v2(const std::string_view& s,
+                      const std::string_view& needle,
+                      size_t padding)
+{
+  return avx2_strstr_v2(
+      s.data(), s.size(), padding, needle.data(), needle.size());
+}
+
+size_t avx512bw_strstr_v2(const std::string_view& s,
+                          const std::string_view& needle,
+                          size_t padding)
+{
+  return avx512bw_strstr_v2(
+      s.data(), s.size(), padding, needle.data(), needle.size());
+}
+#endif
+
+size_t sse2_strcasestr(const std::string_view& s,
+                       const std::string_view& needle,
+                       size_t padding)
+{
+  return sse2_strcasestr(
+      s.data(), s.size(), padding, needle.data(), needle.size());
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+size_t avx2_strcasestr(const std::string_view& s,
+                       const std::string_view& needle,
+                       size_t padding)
+{
+  return avx2_strcasestr(
+      s.data(), s.size(), padding, needle.data(), needle.size());
+}
+
+size_t avx512bw_strcasestr(const std::string_view& s,
+                           const std::string_view& needle,
+                           size_t padding)
+{
+  return avx512bw_strcasestr(
+      s.data(), s.size(), padding, needle.data(), needle.size());
+}
+#endif
+
+// ------------------------------------------------------------------------
+
+namespace
+{
+using strstr_kernel_fn =
+    size_t (*)(const char*, size_t, size_t, const char*, size_t);
+
+struct strstr_kernel
+{
+  const char* name;
+  strstr_kernel_fn fn;
+  strstr_kernel_fn ignore_case_fn;
+};
+
+strstr_kernel select_strstr_kernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw")) {
+    return {"avx512bw", avx512bw_strstr_v2, avx512bw_strcasestr};
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return {"avx2", avx2_strstr_v2, avx2_strcasestr};
+  }
+#endif
+  return {"sse2", sse2_strstr_v2, sse2_strcasestr};
+}
+
+// Resolved once, before main() runs
+const strstr_kernel selected_kernel = select_strstr_kernel();
+
+}  // namespace
+
+size_t simd_strstr(const std::string_view& s,
+                   const std::string_view& needle,
+                   size_t padding)
+{
+  return selected_kernel.fn(
+      s.data(), s.size(), padding, needle.data(), needle.size());
+}
+
+size_t simd_strcasestr(const std::string_view& s,
+                       const std::string_view& needle,
+                       size_t padding)
+{
+  return selected_kernel.ignore_case_fn(
+      s.data(), s.size(), padding, needle.data(), needle.size());
+}
+
+const char* simd_strstr_kernel_name()
 {
-  return sse2_strstr_v2(s.data(), s.size(), needle.data(), needle.size());
+  return selected_kernel.name;
 }
 
 }  // namespace search
@@ -6,8 +6,51 @@
 
 namespace search
 {
+// `padding` is the number of bytes after the end of `s` that may be read
+// (but are never matched). The kernels only load whole blocks, so with
+// enough padding the whole haystack is scanned without a scalar tail.
 size_t sse2_strstr_v2(const std::string_view& s,
-                      const std::string_view& needle);
+                      const std::string_view& needle,
+                      size_t padding = 0);
+
+#  if defined(__x86_64__) || defined(__i386__)
+size_t avx2_strstr_v2(const std::string_view& s,
+                      const std::string_view& needle,
+                      size_t padding = 0);
+
+size_t avx512bw_strstr_v2(const std::string_view& s,
+                          const std::string_view& needle,
+                          size_t padding = 0);
+#  endif
+
+// Runs the widest kernel supported by this CPU (AVX-512BW, AVX2 or SSE2).
+// The kernel is chosen once, at startup.
+size_t simd_strstr(const std::string_view& s,
+                   const std::string_view& needle,
+                   size_t padding = 0);
+
+// The same searches with ASCII letters matching in either case. Only the
+// registers are case folded: neither string is copied.
+size_t sse2_strcasestr(const std::string_view& s,
+                       const std::string_view& needle,
+                       size_t padding = 0);
+
+#  if defined(__x86_64__) || defined(__i386__)
+size_t avx2_strcasestr(const std::string_view& s,
+                       const std::string_view& needle,
+                       size_t padding = 0);
+
+size_t avx512bw_strcasestr(const std::string_view& s,
+                           const std::string_view& needle,
+                           size_t padding = 0);
+#  endif
+
+size_t simd_strcasestr(const std::string_view& s,
+                       const std::string_view& needle,
+                       size_t padding = 0);
+
+// Name of the kernel used by simd_strstr and simd_strcasestr, e.g., "avx2"
+const char* simd_strstr_kernel_name();
 
 }  // namespace search
 
@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <iterator>
+
+#include <fmt/core.h>
+#include <stats.hpp>
+
+namespace search
+{
+stats::tally& stats::local()
+{
+  thread_local tally* counters = nullptr;
+  if (counters == nullptr) {
+    const std::scoped_lock lock(m_mutex);
+    counters = m_tallies.emplace_back(std::make_unique<tally>()).get();
+  }
+  return *counters;
+}
+
+void stats::print(clock::duration wall_time)
+{
+  static constexpr const char* phase_names[] = {
+      "Directory walk",
+      "File read",
+      "Prefilter",
+      "Parse queue wait",
+      "clang_parseTranslationUnit",
+      "clang_visitChildren",
+      "Snippet formatting",
+      "Output",
+  };
+  static constexpr const char* counter_names[] = {
+      "Files seen",
+      "Files excluded",
+      "Prefilter hits",
+      "Prefilter misses",
+      "Translation units parsed",
+      "Translation units with errors",
+      "Results",
+      "Bytes scanned",
+  };
+  static_assert(std::size(phase_names)
+                == static_cast<std::size_t>(phase::count_));
+  static_assert(std::size(counter_names)
+                == static_cast<std::size_t>(counter::count_));
+
+  tally total;
+  {
+    const std::scoped_lock lock(m_mutex);
+    for (const auto& counters : m_tallies) {
+      for (std::size_t i = 0; i < total.times.size(); ++i) {
+        total.times[i] += counters->times[i];
+      }
+      for (std::size_t i = 0; i < total.counters.size(); ++i) {
+        total.counters[i] += counters->counters[i];
+      }
+    }
+  }
+
+  const auto milliseconds = [](clock::duration time)
+  { return std::chrono::duration<double, std::milli>(time).count(); };
+
+  fmt::print(stderr, "\nPhase (ms, summed over threads)\n");
+  for (std::size_t i = 0; i < total.times.size(); ++i) {
+    fmt::print(stderr,
+               "  {:<30} {:>10.3f}\n",
+               phase_names[i],
+               milliseconds(total.times[i]));
+  }
+  fmt::print(
+      stderr, "  {:<30} {:>10.3f}\n", "Wall time", milliseconds(wall_time));
+
+  fmt::print(stderr, "\nCounters\n");
+  for (std::size_t i = 0; i < total.counters.size(); ++i) {
+    fmt::print(
+        stderr, "  {:<30} {:>10}\n", counter_names[i], total.counters[i]);
+  }
+}
+
+}  // namespace search
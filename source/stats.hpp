@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include <trace.hpp>
+
+namespace search
+{
+enum class phase : std::size_t
+{
+  walk,
+  read,
+  prefilter,
+  parse_queue,
+  parse,
+  visit,
+  format,
+  output,
+  count_
+};
+
+enum class counter : std::size_t
+{
+  files_seen,
+  files_excluded,
+  prefilter_hits,
+  prefilter_misses,
+  translation_units,
+  parse_failures,
+  results,
+  bytes_scanned,
+  count_
+};
+
+// --stats: the time spent in each phase of the search, summed over all
+// threads, and a few counters. Every thread records into a tally of its
+// own, so recording takes no locks; the tallies are only summed when
+// printed. Nothing is recorded unless m_enabled is set.
+class stats
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  static inline bool m_enabled;
+
+  static void add(counter c, std::uint64_t n = 1)
+  {
+    if (m_enabled) {
+      local().counters[static_cast<std::size_t>(c)] += n;
+    }
+  }
+
+  static void add_time(phase p, clock::duration time)
+  {
+    local().times[static_cast<std::size_t>(p)] += time;
+  }
+
+  // Writes the totals to stderr. Only call once every search task has
+  // finished.
+  static void print(clock::duration wall_time);
+
+private:
+  struct tally
+  {
+    std::array<clock::duration, static_cast<std::size_t>(phase::count_)>
+        times {};
+    std::array<std::uint64_t, static_cast<std::size_t>(counter::count_)>
+        counters {};
+  };
+
+  static tally& local();
+
+  static inline std::mutex m_mutex;
+  static inline std::vector<std::unique_ptr<tally>> m_tallies;
+};
+
+// Adds the time until it goes out of scope to `p`, and records it as a
+// span for --trace. A timer started while another one is running on the
+// same thread pauses it, so the time of a phase does not include the
+// phases nested in it; the spans are simply nested.
+class phase_timer
+{
+public:
+  explicit phase_timer(phase p)
+      : m_phase(p)
+  {
+    if (!stats::m_enabled && !trace::m_enabled) {
+      return;
+    }
+    m_start = stats::clock::now();
+    m_begin = m_start;
+    m_parent = running();
+    if (m_parent) {
+      m_parent->m_elapsed += m_start - m_parent->m_start;
+    }
+    running() = this;
+    m_active = true;
+  }
+
+  phase_timer(const phase_timer&) = delete;
+  phase_timer& operator=(const phase_timer&) = delete;
+
+  ~phase_timer()
+  {
+    if (!m_active) {
+      return;
+    }
+    const auto now = stats::clock::now();
+    if (stats::m_enabled) {
+      stats::add_time(m_phase, m_elapsed + (now - m_start));
+    }
+    if (trace::m_enabled) {
+      trace::record(m_phase, m_begin, now, m_path, m_size);
+    }
+    if (m_parent) {
+      m_parent->m_start = now;
+    }
+    running() = m_parent;
+  }
+
+  // The file worked on, shown with the trace span. `path` must outlive
+  // the timer.
+  void annotate(std::string_view path, std::uint64_t size)
+  {
+    m_path = path;
+    m_size = size;
+  }
+
+private:
+  static phase_timer*& running()
+  {
+    thread_local phase_timer* timer = nullptr;
+    return timer;
+  }
+
+  phase m_phase;
+  bool m_active {false};
+  phase_timer* m_parent {nullptr};
+  stats::clock::time_point m_start;
+  stats::clock::time_point m_begin;
+  stats::clock::duration m_elapsed {};
+  std::string_view m_path;
+  std::uint64_t m_size {0};
+};
+
+}  // namespace search
@@ -30,14 +30,19 @@
 
 #define THREAD_POOL_VERSION "v2.0.0 (2021-08-14)"
 
+// Modified for fccf: idle workers and wait_for_tasks() block on condition
+// variables instead of sleeping for sleep_duration between polls, as in
+// upstream v3.
+
 #include <atomic>  // std::atomic
 #include <chrono>  // std::chrono
+#include <condition_variable>  // std::condition_variable
 #include <cstdint>  // std::int_fast64_t, std::uint_fast32_t
 #include <functional>  // std::function
 #include <future>  // std::future, std::promise
 #include <iostream>  // std::cout, std::ostream
 #include <memory>  // std::shared_ptr, std::unique_ptr
-#include <mutex>  // std::mutex, std::scoped_lock
+#include <mutex>  // std::mutex, std::scoped_lock, std::unique_lock
 #include <queue>  // std::queue
 #include <thread>  // std::this_thread, std::thread
 #include <type_traits>  // std::common_type_t, std::decay_t, std::enable_if_t, std::is_void_v, std::invoke_result_t
@@ -90,8 +95,7 @@ public:
   ~thread_pool()
   {
     wait_for_tasks();
-    running = false;
-    destroy_threads();
+    stop_threads();
   }
 
   // =======================
@@ -192,6 +196,8 @@ public:
       num_blocks = (ui32)total_size > 1 ? (ui32)total_size : 1;
     }
     std::atomic<ui32> blocks_running = 0;
+    std::mutex blocks_mutex;
+    std::condition_variable blocks_done_cv;
     for (ui32 t = 0; t < num_blocks; t++) {
       T start = ((T)(t * block_size) + the_first_index);
       T end = (t == num_blocks - 1)
@@ -199,15 +205,17 @@ public:
           : ((T)((t + 1) * block_size) + the_first_index);
       blocks_running++;
       push_task(
-          [start, end, &loop, &blocks_running]
+          [&, start, end]
           {
             loop(start, end);
-            blocks_running--;
+            if (--blocks_running == 0) {
+              const std::scoped_lock lock(blocks_mutex);
+              blocks_done_cv.notify_one();
+            }
           });
     }
-    while (blocks_running != 0) {
-      sleep_or_yield();
-    }
+    std::unique_lock<std::mutex> lock(blocks_mutex);
+    blocks_done_cv.wait(lock, [&] { return blocks_running == 0; });
   }
 
   /**
@@ -221,10 +229,14 @@ public:
   void push_task(const F& task)
   {
     tasks_total++;
+    bool wake = false;
     {
       const std::scoped_lock lock(queue_mutex);
       tasks.push(std::function<void()>(task));
+      wake = idle_workers > 0;
     }
+    if (wake)
+      task_available_cv.notify_one();
   }
 
   /**
@@ -265,8 +277,7 @@ public:
     bool was_paused = paused;
     paused = true;
     wait_for_tasks();
-    running = false;
-    destroy_threads();
+    stop_threads();
     thread_count =
         _thread_count ? _thread_count : std::thread::hardware_concurrency();
     threads.reset(new std::thread[thread_count]);
@@ -358,16 +369,16 @@ public:
    */
   void wait_for_tasks()
   {
-    while (true) {
-      if (!paused) {
-        if (tasks_total == 0)
-          break;
-      } else {
-        if (get_tasks_running() == 0)
-          break;
-      }
-      sleep_or_yield();
-    }
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    waiting = true;
+    task_done_cv.wait(lock,
+                      [this]
+                      {
+                        if (!paused)
+                          return tasks_total == 0;
+                        return tasks_total == (ui32)tasks.size();
+                      });
+    waiting = false;
   }
 
   // ===========
@@ -383,10 +394,9 @@ public:
   std::atomic<bool> paused = false;
 
   /**
-   * @brief The duration, in microseconds, that the worker function should sleep
-   * for when it cannot find any tasks in the queue. If set to 0, then instead
-   * of sleeping, the worker function will execute std::this_thread::yield() if
-   * there are no tasks in the queue. The default value is 1000.
+   * @brief The interval, in microseconds, at which idle workers check whether
+   * the pool was unpaused. Workers of a pool that is not paused are woken up
+   * as soon as a task is pushed and never poll. The default value is 1000.
    */
   ui32 sleep_duration = 1000;
 
@@ -406,62 +416,58 @@ private:
   }
 
   /**
-   * @brief Destroy the threads in the pool by joining them.
+   * @brief Tell the workers to stop, wake up the idle ones, and join all the
+   * threads in the pool.
    */
-  void destroy_threads()
+  void stop_threads()
   {
+    {
+      const std::scoped_lock lock(queue_mutex);
+      running = false;
+    }
+    task_available_cv.notify_all();
     for (ui32 i = 0; i < thread_count; i++) {
       threads[i].join();
     }
   }
 
-  /**
-   * @brief Try to pop a new task out of the queue.
-   *
-   * @param task A reference to the task. Will be populated with a function if
-   * the queue is not empty.
-   * @return true if a task was found, false if the queue is empty.
-   */
-  bool pop_task(std::function<void()>& task)
-  {
-    const std::scoped_lock lock(queue_mutex);
-    if (tasks.empty())
-      return false;
-    else {
-      task = std::move(tasks.front());
-      tasks.pop();
-      return true;
-    }
-  }
-
-  /**
-   * @brief Sleep for sleep_duration microseconds. If that variable is set to
-   * zero, yield instead.
-   *
-   */
-  void sleep_or_yield()
-  {
-    if (sleep_duration)
-      std::this_thread::sleep_for(std::chrono::microseconds(sleep_duration));
-    else
-      std::this_thread::yield();
-  }
-
   /**
    * @brief A worker function to be assigned to each thread in the pool.
-   * Continuously pops tasks out of the queue and executes them, as long as the
-   * atomic variable running is set to true.
+   * Blocks until a task is available, pops it out of the queue and executes
+   * it, as long as the atomic variable running is set to true.
    */
   void worker()
   {
-    while (running) {
-      std::function<void()> task;
-      if (!paused && pop_task(task)) {
-        task();
-        tasks_total--;
-      } else {
-        sleep_or_yield();
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (true) {
+      // Tasks often come in quick succession (e.g., one per file found
+      // in a directory), so yield a few times before going to sleep
+      for (ui32 spins = 0; spins < spin_count && running && tasks.empty();
+           spins++) {
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+      }
+      while (running && (paused || tasks.empty())) {
+        idle_workers++;
+        // Nothing notifies the workers when the pool is unpaused
+        if (paused)
+          task_available_cv.wait_for(
+              lock, std::chrono::microseconds(sleep_duration));
+        else
+          task_available_cv.wait(lock);
+        idle_workers--;
       }
+      if (!running)
+        break;
+      std::function<void()> task = std::move(tasks.front());
+      tasks.pop();
+      lock.unlock();
+      task();
+      lock.lock();
+      tasks_total--;
+      if (waiting)
+        task_done_cv.notify_all();
     }
   }
 
@@ -475,6 +481,35 @@ private:
    */
   mutable std::mutex queue_mutex = {};
 
+  /**
+   * @brief Notified when a task is pushed into the queue, or when the workers
+   * should stop.
+   */
+  std::condition_variable task_available_cv = {};
+
+  /**
+   * @brief Notified when a task finishes while wait_for_tasks() is waiting.
+   */
+  std::condition_variable task_done_cv = {};
+
+  /**
+   * @brief Whether wait_for_tasks() is waiting. Guarded by queue_mutex.
+   */
+  bool waiting = false;
+
+  /**
+   * @brief The number of workers blocked on task_available_cv, so pushing a
+   * task only makes a system call when a worker needs to be woken up. Guarded
+   * by queue_mutex.
+   */
+  ui32 idle_workers = 0;
+
+  /**
+   * @brief How many times an idle worker yields, checking for new tasks,
+   * before it blocks.
+   */
+  static constexpr ui32 spin_count = 16;
+
   /**
    * @brief An atomic variable indicating to the workers to keep running. When
    * set to false, the workers permanently stop working.
@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+#include <json_lines.hpp>
+#include <stats.hpp>
+#include <trace.hpp>
+
+namespace search
+{
+void trace::start()
+{
+  m_start = clock::now();
+  m_enabled = true;
+}
+
+trace::ring& trace::local()
+{
+  thread_local ring* buffer = nullptr;
+  if (buffer == nullptr) {
+    const std::scoped_lock lock(m_mutex);
+    buffer =
+        m_rings.emplace_back(std::make_unique<ring>(m_rings.size() + 1)).get();
+  }
+  return *buffer;
+}
+
+void trace::record(phase p,
+                   clock::time_point begin,
+                   clock::time_point end,
+                   std::string_view path,
+                   std::uint64_t size)
+{
+  auto& buffer = local();
+  if (buffer.spans.size() < ring_size) {
+    buffer.spans.emplace_back();
+  }
+  // Once the ring is full, this overwrites the oldest span
+  auto& s = buffer.spans[buffer.recorded % ring_size];
+  s.p = p;
+  s.begin = begin;
+  s.end = end;
+  s.size = size;
+  // The end of a long path tells more than its beginning
+  s.path_truncated = path.size() > max_path_size;
+  if (s.path_truncated) {
+    path.remove_prefix(path.size() - max_path_size);
+  }
+  s.path_size = static_cast<std::uint8_t>(path.size());
+  std::memcpy(s.path.data(), path.data(), path.size());
+  ++buffer.recorded;
+}
+
+bool trace::write(const std::string& path)
+{
+  static constexpr const char* phase_names[] = {
+      "walk",
+      "read",
+      "prefilter",
+      "parse queue wait",
+      "parse",
+      "visit",
+      "format",
+      "output",
+  };
+  static_assert(std::size(phase_names)
+                == static_cast<std::size_t>(phase::count_));
+
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  const auto microseconds = [](clock::duration time)
+  { return std::chrono::duration<double, std::micro>(time).count(); };
+
+  fmt::memory_buffer out;
+  std::size_t dropped = 0;
+  bool first = true;
+  out.append(std::string_view {"{\"traceEvents\":[\n"});
+
+  const std::scoped_lock lock(m_mutex);
+  for (const auto& buffer : m_rings) {
+    dropped += buffer->recorded - buffer->spans.size();
+    for (const auto& s : buffer->spans) {
+      if (!first) {
+        out.append(std::string_view {",\n"});
+      }
+      first = false;
+      fmt::format_to(std::back_inserter(out),
+                     "{{\"name\":\"{}\",\"cat\":\"fccf\",\"ph\":\"X\","
+                     "\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{}",
+                     phase_names[static_cast<std::size_t>(s.p)],
+                     microseconds(s.begin - m_start),
+                     microseconds(s.end - s.begin),
+                     buffer->id);
+      if (s.path_size != 0) {
+        out.append(std::string_view {",\"args\":{\"path\":"});
+        const std::string_view span_path {s.path.data(), s.path_size};
+        if (s.path_truncated) {
+          append_json_string(out, "..." + std::string {span_path});
+        } else {
+          append_json_string(out, span_path);
+        }
+        fmt::format_to(std::back_inserter(out), ",\"size\":{}}}", s.size);
+      }
+      out.push_back('}');
+    }
+    // Flush as we go, so the buffer stays small
+    if (std::fwrite(out.data(), 1, out.size(), file) != out.size()) {
+      std::fclose(file);
+      return false;
+    }
+    out.clear();
+  }
+
+  fmt::format_to(std::back_inserter(out),
+                 "\n],\"displayTimeUnit\":\"ms\","
+                 "\"otherData\":{{\"droppedSpans\":{}}}}}\n",
+                 dropped);
+  const bool written =
+      std::fwrite(out.data(), 1, out.size(), file) == out.size();
+  return std::fclose(file) == 0 && written;
+}
+
+}  // namespace search
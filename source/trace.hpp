@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace search
+{
+enum class phase : std::size_t;
+
+// --trace: a timeline of the spans timed by phase_timer, written in the
+// Chrome trace-event format (for Perfetto or chrome://tracing). Every
+// thread records into a ring buffer of its own, which keeps the most
+// recent `ring_size` spans; the buffers are only written out at exit.
+// Nothing is recorded unless m_enabled is set.
+class trace
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t ring_size = 1 << 16;
+  static constexpr std::size_t max_path_size = 80;
+
+  static inline bool m_enabled;
+
+  // Sets m_enabled; span times are relative to this call
+  static void start();
+
+  // `path` and `size` are the file the span worked on, if any. Paths
+  // longer than max_path_size keep their last max_path_size bytes.
+  static void record(phase p,
+                     clock::time_point begin,
+                     clock::time_point end,
+                     std::string_view path,
+                     std::uint64_t size);
+
+  // Only call once every search task has finished
+  static bool write(const std::string& path);
+
+private:
+  struct span
+  {
+    phase p;
+    clock::time_point begin;
+    clock::time_point end;
+    std::uint64_t size;
+    // Stored inline, so that recording a span never allocates
+    std::uint8_t path_size;
+    bool path_truncated;
+    std::array<char, max_path_size> path;
+  };
+
+  struct ring
+  {
+    explicit ring(std::size_t thread_id)
+        : id(thread_id)
+    {
+    }
+
+    std::size_t id;
+    std::vector<span> spans;
+    // Total spans recorded; spans[recorded % ring_size] is the next slot
+    std::size_t recorded {0};
+  };
+
+  static ring& local();
+
+  static inline clock::time_point m_start;
+  static inline std::mutex m_mutex;
+  static inline std::vector<std::unique_ptr<ring>> m_rings;
+};
+
+}  // namespace search
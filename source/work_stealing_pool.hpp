@@ -0,0 +1,363 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace search
+{
+// A Chase-Lev work-stealing deque of tasks ("Dynamic Circular Work-Stealing
+// Deque", with the memory orderings of Lê et al., PPoPP 2013). Only the
+// owning worker pushes and pops at the bottom; any thread may steal from
+// the top. No locks are taken on either path.
+class task_deque
+{
+public:
+  using task = std::function<void()>;
+
+  task_deque()
+      : m_ring(new ring(initial_capacity))
+  {
+    m_rings.emplace_back(m_ring.load(std::memory_order_relaxed));
+  }
+
+  task_deque(const task_deque&) = delete;
+  task_deque& operator=(const task_deque&) = delete;
+
+  ~task_deque()
+  {
+    while (task* t = pop()) {
+      delete t;
+    }
+  }
+
+  // Owner only
+  void push(task* t)
+  {
+    const auto bottom = m_bottom.load(std::memory_order_relaxed);
+    const auto top = m_top.load(std::memory_order_acquire);
+    ring* r = m_ring.load(std::memory_order_relaxed);
+    if (bottom - top > r->capacity - 1) {
+      r = grow(r, top, bottom);
+    }
+    r->put(bottom, t);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only; the most recently pushed task, or nullptr
+  task* pop()
+  {
+    const auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    ring* r = m_ring.load(std::memory_order_relaxed);
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    task* t = r->get(bottom);
+    if (top == bottom) {
+      // The last task; race the thieves for it
+      if (!m_top.compare_exchange_strong(top,
+                                         top + 1,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+      {
+        t = nullptr;
+      }
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return t;
+  }
+
+  // Any thread; the oldest task, or nullptr if the deque is empty or
+  // another thread got to it first
+  task* steal()
+  {
+    auto top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return nullptr;
+    }
+    task* t = m_ring.load(std::memory_order_acquire)->get(top);
+    if (!m_top.compare_exchange_strong(top,
+                                       top + 1,
+                                       std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+    {
+      return nullptr;
+    }
+    return t;
+  }
+
+  bool empty() const
+  {
+    return m_bottom.load(std::memory_order_seq_cst)
+        <= m_top.load(std::memory_order_seq_cst);
+  }
+
+private:
+  static constexpr std::int64_t initial_capacity = 256;
+
+  struct ring
+  {
+    explicit ring(std::int64_t size)
+        : capacity(size)
+        , slots(new std::atomic<task*>[static_cast<std::size_t>(size)])
+    {
+    }
+
+    task* get(std::int64_t i) const
+    {
+      return slots[index(i)].load(std::memory_order_relaxed);
+    }
+
+    void put(std::int64_t i, task* t)
+    {
+      slots[index(i)].store(t, std::memory_order_relaxed);
+    }
+
+    // The capacity is a power of two, so this wraps i around the ring
+    std::size_t index(std::int64_t i) const
+    {
+      return static_cast<std::size_t>(i)
+          & static_cast<std::size_t>(capacity - 1);
+    }
+
+    const std::int64_t capacity;
+    std::unique_ptr<std::atomic<task*>[]> slots;
+  };
+
+  ring* grow(ring* old, std::int64_t top, std::int64_t bottom)
+  {
+    auto* bigger = new ring(old->capacity * 2);
+    for (auto i = top; i < bottom; ++i) {
+      bigger->put(i, old->get(i));
+    }
+    // Thieves may still be reading the old ring; it is freed with the
+    // deque
+    m_rings.emplace_back(bigger);
+    m_ring.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+  alignas(64) std::atomic<std::int64_t> m_top {0};
+  alignas(64) std::atomic<std::int64_t> m_bottom {0};
+  std::atomic<ring*> m_ring;
+  std::vector<std::unique_ptr<ring>> m_rings;
+};
+
+// A thread pool where each worker has its own task_deque. Tasks pushed by
+// a worker (e.g., the subdirectories and files found by the walker) go to
+// its own deque and are run newest first; idle workers steal the oldest
+// tasks of random victims. Tasks pushed from other threads go through a
+// shared injection queue.
+//
+// Same interface as thread_pool, as far as fccf uses it.
+class work_stealing_pool
+{
+public:
+  explicit work_stealing_pool(
+      std::size_t thread_count = std::thread::hardware_concurrency())
+      : m_workers(thread_count ? thread_count
+                               : std::thread::hardware_concurrency())
+  {
+    for (std::size_t i = 0; i < m_workers.size(); ++i) {
+      m_workers[i].deque = std::make_unique<task_deque>();
+    }
+    for (std::size_t i = 0; i < m_workers.size(); ++i) {
+      m_workers[i].thread = std::thread(&work_stealing_pool::worker, this, i);
+    }
+  }
+
+  work_stealing_pool(const work_stealing_pool&) = delete;
+  work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+  ~work_stealing_pool()
+  {
+    wait_for_tasks();
+    {
+      const std::scoped_lock lock(m_sleep_mutex);
+      m_running = false;
+    }
+    m_work_available.notify_all();
+    for (auto& w : m_workers) {
+      w.thread.join();
+    }
+  }
+
+  std::size_t get_thread_count() const { return m_workers.size(); }
+
+  template<typename F>
+  void push_task(const F& task)
+  {
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    auto* t = new task_deque::task(task);
+
+    const auto& self = current_worker();
+    if (self.pool == this) {
+      m_workers[self.index].deque->push(t);
+    } else {
+      const std::scoped_lock lock(m_injection_mutex);
+      m_injected.push_back(t);
+      m_injected_count.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // Pairs with the fence in worker() before it rechecks for work
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_idle.load(std::memory_order_relaxed) > 0) {
+      const std::scoped_lock lock(m_sleep_mutex);
+      m_work_available.notify_one();
+    }
+  }
+
+  // Waits until every pushed task, including the ones pushed by tasks,
+  // has finished
+  void wait_for_tasks()
+  {
+    std::unique_lock<std::mutex> lock(m_done_mutex);
+    m_done.wait(lock,
+                [this]
+                { return m_pending.load(std::memory_order_acquire) == 0; });
+  }
+
+private:
+  struct worker_state
+  {
+    std::unique_ptr<task_deque> deque;
+    std::thread thread;
+  };
+
+  struct worker_identity
+  {
+    const work_stealing_pool* pool {nullptr};
+    std::size_t index {0};
+  };
+
+  static worker_identity& current_worker()
+  {
+    thread_local worker_identity identity;
+    return identity;
+  }
+
+  task_deque::task* pop_injected()
+  {
+    if (m_injected_count.load(std::memory_order_relaxed) == 0) {
+      return nullptr;
+    }
+    const std::scoped_lock lock(m_injection_mutex);
+    if (m_injected.empty()) {
+      return nullptr;
+    }
+    auto* t = m_injected.front();
+    m_injected.pop_front();
+    m_injected_count.fetch_sub(1, std::memory_order_relaxed);
+    return t;
+  }
+
+  task_deque::task* find_task(std::size_t index, std::uint64_t& rng)
+  {
+    if (auto* t = m_workers[index].deque->pop()) {
+      return t;
+    }
+    if (auto* t = pop_injected()) {
+      return t;
+    }
+    // Visit every other worker once, starting at a random one
+    const auto count = m_workers.size();
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    const auto first = static_cast<std::size_t>(rng % count);
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto victim = (first + i) % count;
+      if (victim == index) {
+        continue;
+      }
+      if (auto* t = m_workers[victim].deque->steal()) {
+        return t;
+      }
+    }
+    return nullptr;
+  }
+
+  bool has_work() const
+  {
+    if (m_injected_count.load(std::memory_order_seq_cst) > 0) {
+      return true;
+    }
+    for (const auto& w : m_workers) {
+      if (!w.deque->empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void worker(std::size_t index)
+  {
+    current_worker() = {this, index};
+    std::uint64_t rng = 0x9e3779b97f4a7c15ull * (index + 1);
+
+    while (true) {
+      task_deque::task* t = nullptr;
+      // Yield a few times before sleeping; tasks tend to arrive in bursts
+      for (unsigned spins = 0; spins < spin_count && t == nullptr; ++spins) {
+        t = find_task(index, rng);
+        if (t == nullptr) {
+          std::this_thread::yield();
+        }
+      }
+
+      if (t != nullptr) {
+        (*t)();
+        delete t;
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          const std::scoped_lock lock(m_done_mutex);
+          m_done.notify_all();
+        }
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(m_sleep_mutex);
+      m_idle.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (m_running && !has_work()) {
+        m_work_available.wait(lock);
+      }
+      m_idle.fetch_sub(1, std::memory_order_relaxed);
+      if (!m_running) {
+        return;
+      }
+    }
+  }
+
+  static constexpr unsigned spin_count = 16;
+
+  std::vector<worker_state> m_workers;
+
+  std::mutex m_injection_mutex;
+  std::deque<task_deque::task*> m_injected;
+  std::atomic<std::size_t> m_injected_count {0};
+
+  std::mutex m_sleep_mutex;
+  std::condition_variable m_work_available;
+  std::atomic<std::size_t> m_idle {0};
+  bool m_running {true};
+
+  std::atomic<std::size_t> m_pending {0};
+  std::mutex m_done_mutex;
+  std::condition_variable m_done;
+};
+
+}  // namespace search
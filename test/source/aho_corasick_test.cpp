@@ -0,0 +1,203 @@
+// Tests of the Aho-Corasick automaton used to prefilter files for several
+// queries at once: overlapping, duplicate and empty patterns,
+// ignore_case, the early exit once every pattern is found, and random
+// pattern sets checked against a find per pattern.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <aho_corasick.hpp>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+char to_lower(char c)
+{
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// What find() should report: a search per pattern
+std::vector<bool> expected_found(const std::vector<std::string_view>& patterns,
+                                 std::string_view text,
+                                 bool ignore_case)
+{
+  std::vector<bool> found;
+  for (const auto pattern : patterns) {
+    found.push_back(!pattern.empty()
+                    && std::search(text.begin(),
+                                   text.end(),
+                                   pattern.begin(),
+                                   pattern.end(),
+                                   [ignore_case](char a, char b)
+                                   {
+                                     return ignore_case
+                                         ? to_lower(a) == to_lower(b)
+                                         : a == b;
+                                   })
+                        != text.end());
+  }
+  return found;
+}
+
+struct find_case
+{
+  std::vector<std::string_view> patterns;
+  const char* text;
+  bool ignore_case;
+  std::vector<bool> expected;
+};
+
+void test_cases()
+{
+  const find_case cases[] = {
+      // Overlapping patterns, found through the failure links
+      {{"he", "she", "his", "hers"},
+       "ushers",
+       false,
+       {true, true, false, true}},
+      {{"he", "she", "his", "hers"},
+       "ahishe",
+       false,
+       {true, true, true, false}},
+      {{"he", "she", "his", "hers"},
+       "h",
+       false,
+       {false, false, false, false}},
+      {{"a", "aa", "aaa"}, "aa", false, {true, true, false}},
+      {{"abcd", "bc"}, "xabcx", false, {false, true}},
+      // Duplicates are each reported
+      {{"he", "he", "she"}, "she", false, {true, true, true}},
+      {{"he", "he"}, "hx", false, {false, false}},
+      // Empty patterns are never found
+      {{"", "he"}, "he", false, {false, true}},
+      {{""}, "", false, {false}},
+      {{}, "anything", false, {}},
+      // Case
+      {{"Size", "SIZE"}, "size", false, {false, false}},
+      {{"Size", "SIZE"}, "size", true, {true, true}},
+      {{"m_Value"}, "M_VALUE", true, {true}},
+      // Only letters are folded: `@` and `[` sit next to `A` and `Z`
+      {{"@"}, "`", true, {false}},
+      {{"["}, "{", true, {false}},
+  };
+  for (const auto& c : cases) {
+    const search::aho_corasick automaton {c.patterns, c.ignore_case};
+    std::vector<bool> found(c.patterns.size());
+    const auto newly_found = automaton.find(c.text, found);
+    const auto what = std::string {"find in '"} + c.text + "'"
+        + (c.ignore_case ? " (icase)" : "");
+    check(found == c.expected, what);
+    check(newly_found
+              == static_cast<std::size_t>(
+                  std::count(c.expected.begin(), c.expected.end(), true)),
+          what + ": count");
+  }
+}
+
+void test_already_found()
+{
+  const search::aho_corasick automaton {{"he", "she", "hers"}};
+  // Patterns that were found before are kept and not counted again
+  std::vector<bool> found {true, false, false};
+  check(automaton.find("ushers", found) == 2, "already found: count");
+  check(found == std::vector<bool> {true, true, true}, "already found");
+  check(automaton.find("ushers", found) == 0, "all found: count");
+}
+
+void test_early_exit()
+{
+  // The text runs into an unreadable page: the scan has to stop at the
+  // last pattern found, at the end of the readable one
+  const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  void* mapping = ::mmap(nullptr,
+                         2 * page_size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1,
+                         0);
+  if (mapping == MAP_FAILED) {
+    check(false, "mmap");
+    return;
+  }
+  auto* page = static_cast<char*>(mapping);
+  std::memset(page, 'x', page_size);
+  const std::string_view tail = "hers";
+  std::memcpy(page + page_size - tail.size(), tail.data(), tail.size());
+  ::mprotect(page + page_size, page_size, PROT_NONE);
+
+  const std::string_view text {page, 2 * page_size};
+  // The empty pattern, which is never found, must not keep it going
+  const search::aho_corasick automaton {{"he", "", "hers"}};
+  std::vector<bool> found(3);
+  check(automaton.find(text, found) == 2, "early exit: count");
+  check(found == std::vector<bool> {true, false, true}, "early exit");
+
+  const search::aho_corasick folded {{"HE", "Hers"}, true};
+  std::vector<bool> folded_found(2);
+  check(folded.find(text, folded_found) == 2, "early exit (icase)");
+
+  ::munmap(mapping, 2 * page_size);
+}
+
+void test_random()
+{
+  // A small alphabet makes for many overlaps; `@` and `[` check that
+  // only letters are folded
+  static const char alphabet[] = "abAB@[";
+  std::mt19937 rng(5);
+  for (int i = 0; i < 20000; ++i) {
+    std::vector<std::string> patterns(1 + rng() % 8);
+    for (auto& pattern : patterns) {
+      pattern.resize(rng() % 5);
+      for (auto& c : pattern) {
+        c = alphabet[rng() % (sizeof(alphabet) - 1)];
+      }
+    }
+    std::string text(rng() % 60, 'x');
+    for (auto& c : text) {
+      c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    const std::vector<std::string_view> views(patterns.begin(),
+                                              patterns.end());
+    for (const bool ignore_case : {false, true}) {
+      const search::aho_corasick automaton {views, ignore_case};
+      std::vector<bool> found(views.size());
+      automaton.find(text, found);
+      check(found == expected_found(views, text, ignore_case),
+            "random patterns in '" + text + "'"
+                + (ignore_case ? " (icase)" : ""));
+    }
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  test_cases();
+  test_already_found();
+  test_early_exit();
+  test_random();
+
+  if (failures != 0) {
+    return 1;
+  }
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,82 @@
+// Runs the fccf executable with -p on a relative search path. Files
+// listed in the compilation database are parsed with their own working
+// directory, so fccf has to hand them to libclang by absolute path.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+void write_file(const fs::path& path, const std::string& content)
+{
+  fs::create_directories(path.parent_path());
+  std::ofstream(path) << content;
+}
+
+int fail(const std::string& message, const std::string& output)
+{
+  std::fprintf(stderr, "%s\n%s", message.c_str(), output.c_str());
+  return 1;
+}
+
+}  // namespace
+
+int main()
+{
+  const auto root =
+      fs::temp_directory_path() / ("fccf_compilation_database_test_"
+                                   + std::to_string(::getpid()));
+  fs::remove_all(root);
+
+  // Widget only exists with the flags from the database, and its base is
+  // found through an include directory relative to the entry directory.
+  // As with CMake, that directory is the build directory, not the one
+  // fccf runs in.
+  write_file(root / "include" / "widget_base.hpp", "struct widget_base {};\n");
+  write_file(root / "src" / "a.cpp",
+             "#include \"widget_base.hpp\"\n"
+             "#ifdef FROM_DATABASE\n"
+             "class Widget : widget_base {};\n"
+             "#endif\n");
+  write_file(root / "build" / "compile_commands.json",
+             "[{\"directory\": \"" + (root / "build").string()
+                 + "\", \"command\": \"c++ -DFROM_DATABASE -I../include -c "
+                   "../src/a.cpp -o a.o\", \"file\": \"../src/a.cpp\"}]\n");
+
+  fs::current_path(root);
+  const auto command =
+      std::string {FCCF_EXECUTABLE} + " --nc -p build --class Widget . 2>&1";
+  std::FILE* pipe = ::popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    return fail("cannot run " + command, "");
+  }
+  std::string output;
+  char buffer[512];
+  while (std::fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+    output += buffer;
+  }
+  const int status = ::pclose(pipe);
+  fs::current_path(root.parent_path());
+  fs::remove_all(root);
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    return fail("fccf failed", output);
+  }
+  if (output.find("class Widget") == std::string::npos) {
+    return fail("Widget was not found", output);
+  }
+  if (output.find("error") != std::string::npos
+      || output.find("Error") != std::string::npos)
+  {
+    return fail("fccf reported an error", output);
+  }
+  std::printf("ok\n");
+  return 0;
+}
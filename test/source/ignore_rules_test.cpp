@@ -0,0 +1,263 @@
+// Table-driven tests of the glob matcher and of the .gitignore rules built
+// on it: negation, anchored and directory-only patterns, `**`, character
+// classes and the precedence of nested ignore files.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <glob.hpp>
+#include <ignore_rules.hpp>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+struct glob_case
+{
+  const char* pattern;
+  bool pathname;
+  const char* text;
+  bool expected;
+};
+
+constexpr glob_case glob_cases[] = {
+    {"foo", false, "foo", true},
+    {"foo", false, "foobar", false},
+    {"f?o", false, "fao", true},
+    {"f?o", false, "fo", false},
+    {"*.cpp", false, "main.cpp", true},
+    {"*.cpp", false, "main.cpp.orig", false},
+    {"*", false, "", true},
+    {"a*b*c", false, "aXbYbZc", true},
+    {"a*b*c", false, "aXbYbZ", false},
+    // Character classes: sets, ranges and negation
+    {"[abc].h", false, "b.h", true},
+    {"[abc].h", false, "d.h", false},
+    {"[a-c][0-9]", false, "b7", true},
+    {"[a-c][0-9]", false, "b-", false},
+    {"[!a-c]x", false, "dx", true},
+    {"[!a-c]x", false, "ax", false},
+    {"[^a-c]x", false, "ax", false},
+    {"[]]", false, "]", true},
+    // Escapes
+    {"\\*", false, "*", true},
+    {"\\*", false, "a", false},
+    {"a\\?", false, "a?", true},
+    // Without `pathname`, `/` is an ordinary character
+    {"a*c", false, "a/b/c", true},
+    {"a?c", false, "a/c", true},
+    // With it, wildcards stop at `/`
+    {"a*c", true, "a/b/c", false},
+    {"a?c", true, "a/c", false},
+    {"a/*/c", true, "a/b/c", true},
+    {"a/*/c", true, "a/b/d/c", false},
+    // `**` matches any number of directories, including none
+    {"**/foo", true, "foo", true},
+    {"**/foo", true, "a/b/foo", true},
+    {"**/foo", true, "a/b/foobar", false},
+    {"a/**/b", true, "a/b", true},
+    {"a/**/b", true, "a/x/y/b", true},
+    {"a/**/b", true, "b/x/b", false},
+    {"a/**", true, "a/x/y", true},
+    {"a/**", true, "b/x", false},
+};
+
+struct rules_case
+{
+  const char* patterns;
+  const char* name;
+  const char* relative_path;
+  bool is_dir;
+  search::ignore_rules::result expected;
+};
+
+constexpr auto none = search::ignore_rules::result::none;
+constexpr auto ignored = search::ignore_rules::result::ignored;
+constexpr auto whitelisted = search::ignore_rules::result::whitelisted;
+
+constexpr rules_case rules_cases[] = {
+    // Names and extensions match at any depth
+    {"*.o\n", "a.o", "src/a.o", false, ignored},
+    {"*.o\n", "a.c", "src/a.c", false, none},
+    {"core\n", "core", "a/b/core", false, ignored},
+    {"core\n", "core", "a/b/core", true, ignored},
+    {"*.tar.gz\n", "x.tar.gz", "x.tar.gz", false, ignored},
+    // Comments, blank lines, trailing spaces and CRLF line endings
+    {"# *.o\n\n", "a.o", "a.o", false, none},
+    {"*.o   \r\n", "a.o", "a.o", false, ignored},
+    {"\\#keep\n", "#keep", "#keep", false, ignored},
+    // Directory-only patterns
+    {"out/\n", "out", "out", true, ignored},
+    {"out/\n", "out", "out", false, none},
+    {"out/\n", "out", "src/out", true, ignored},
+    // A leading or inner slash anchors the pattern
+    {"/out\n", "out", "out", true, ignored},
+    {"/out\n", "out", "src/out", true, none},
+    {"doc/*.txt\n", "a.txt", "doc/a.txt", false, ignored},
+    {"doc/*.txt\n", "a.txt", "src/doc/a.txt", false, none},
+    {"doc/*.txt\n", "a.txt", "doc/x/a.txt", false, none},
+    // `**`
+    {"**/gen\n", "gen", "a/b/gen", true, ignored},
+    {"src/**/gen\n", "gen", "src/gen", true, ignored},
+    {"src/**/gen\n", "gen", "src/a/b/gen", true, ignored},
+    {"src/**/gen\n", "gen", "lib/a/gen", true, none},
+    // Character classes
+    {"*.[oa]\n", "x.a", "x.a", false, ignored},
+    {"*.[oa]\n", "x.so", "x.so", false, none},
+    {"test[0-9]\n", "test3", "test3", false, ignored},
+    {"test[!0-9]\n", "test3", "test3", false, none},
+    // Negation: the last matching pattern decides
+    {"*.log\n!keep.log\n", "keep.log", "keep.log", false, whitelisted},
+    {"*.log\n!keep.log\n", "other.log", "other.log", false, ignored},
+    {"!keep.log\n*.log\n", "keep.log", "keep.log", false, ignored},
+    {"*.log\n!keep.log\n", "a.c", "a.c", false, none},
+    {"\\!important\n", "!important", "!important", false, ignored},
+    {"build/\n!build/\n", "build", "build", true, whitelisted},
+};
+
+// A context for the directory `base`, below `parent`
+std::shared_ptr<const search::ignore_context> make_context(
+    std::shared_ptr<const search::ignore_context> parent,
+    std::string base,
+    std::string_view patterns)
+{
+  auto context = std::make_shared<search::ignore_context>();
+  context->parent = std::move(parent);
+  context->base = std::move(base);
+  context->in_git_repo = true;
+  context->rules.add_patterns(patterns);
+  return context;
+}
+
+void test_nested_precedence()
+{
+  // /r/.gitignore, /r/sub/.gitignore and /r/sub/deep/.gitignore
+  const auto root = make_context(nullptr, "/r", "*.log\n/sub/x\nbuild/\n");
+  const auto sub = make_context(root, "/r/sub", "!keep.log\n/y\n");
+  const auto deep = make_context(sub, "/r/sub/deep", "keep.log\n");
+
+  struct nested_case
+  {
+    const search::ignore_context* context;
+    const char* path;
+    const char* name;
+    bool is_dir;
+    bool expected;
+  };
+  const nested_case cases[] = {
+      {root.get(), "/r/a.log", "a.log", false, true},
+      {root.get(), "/r/keep.log", "keep.log", false, true},
+      // A child's negation overrides its parent's pattern...
+      {sub.get(), "/r/sub/keep.log", "keep.log", false, false},
+      {sub.get(), "/r/sub/a.log", "a.log", false, true},
+      // ...and a grandchild's pattern overrides the negation
+      {deep.get(), "/r/sub/deep/keep.log", "keep.log", false, true},
+      {deep.get(), "/r/sub/deep/a.c", "a.c", false, false},
+      // Anchored patterns are relative to the file they are read from
+      {sub.get(), "/r/sub/x", "x", false, true},
+      {sub.get(), "/r/sub/y", "y", false, true},
+      {deep.get(), "/r/sub/deep/y", "y", false, false},
+      {deep.get(), "/r/sub/deep/x", "x", false, false},
+      {deep.get(), "/r/sub/deep/build", "build", true, true},
+  };
+  for (const auto& c : cases) {
+    check(search::is_ignored(c.context, c.path, c.name, c.is_dir)
+              == c.expected,
+          std::string {"nested: "} + c.path);
+  }
+}
+
+void write_file(const fs::path& path, const std::string& content)
+{
+  fs::create_directories(path.parent_path());
+  std::ofstream(path) << content;
+}
+
+void test_root_context()
+{
+  const auto repo = fs::temp_directory_path()
+      / ("fccf_ignore_rules_test_" + std::to_string(::getpid()));
+  fs::remove_all(repo);
+  fs::create_directories(repo / ".git" / "info");
+  write_file(repo / ".git" / "info" / "exclude", "*.tmp\n");
+  write_file(repo / ".gitignore", "*.log\n/src/gen/\n");
+  write_file(repo / "src" / ".gitignore", "!keep.log\n");
+  fs::create_directories(repo / "src" / "gen");
+
+  const auto previous = fs::current_path();
+  fs::current_path(repo / "src");
+  // "." and "./" must not make src its own ancestor: its .gitignore is
+  // read when it is walked, not here
+  const std::string roots[] = {
+      ".", "./", (repo / "src").string(), (repo / "src").string() + "/"};
+  for (const auto& root : roots) {
+    const auto context = search::root_ignore_context(root);
+    int depth = 0;
+    for (auto c = context.get(); c != nullptr; c = c->parent.get()) {
+      ++depth;
+    }
+    // Only the repository's top directory, whose .gitignore and
+    // .git/info/exclude are read into one context
+    check(depth == 1, "root context depth for " + root);
+    if (!context) {
+      continue;
+    }
+    check(context->prefix == "src/", "root context prefix for " + root);
+    const auto path = [&](const char* name)
+    { return root + (root.back() == '/' ? "" : "/") + name; };
+    check(search::is_ignored(context.get(), path("a.log"), "a.log", false),
+          "a.log below " + root);
+    check(search::is_ignored(context.get(), path("a.tmp"), "a.tmp", false),
+          "a.tmp below " + root);
+    check(search::is_ignored(context.get(), path("gen"), "gen", true),
+          "gen below " + root);
+    check(!search::is_ignored(context.get(), path("a.c"), "a.c", false),
+          "a.c below " + root);
+  }
+  fs::current_path(previous);
+  fs::remove_all(repo);
+}
+
+}  // namespace
+
+int main()
+{
+  for (const auto& c : glob_cases) {
+    const search::glob pattern {c.pattern, c.pathname};
+    check(pattern.matches(c.text) == c.expected,
+          std::string {"glob "} + c.pattern + (c.pathname ? " (path) " : " ")
+              + "on " + c.text);
+  }
+
+  for (const auto& c : rules_cases) {
+    search::ignore_rules rules;
+    rules.add_patterns(c.patterns);
+    check(rules.match(c.name, c.relative_path, c.is_dir) == c.expected,
+          std::string {"rules "} + c.patterns + "on " + c.relative_path
+              + (c.is_dir ? "/" : ""));
+  }
+
+  test_nested_precedence();
+  test_root_context();
+
+  if (failures != 0) {
+    return 1;
+  }
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,207 @@
+// Tests of the --json-lines output: every line must parse as JSON
+// whatever the bytes of the paths and snippets, with control characters,
+// quotes and backslashes escaped and invalid UTF-8 replaced by U+FFFD.
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+#include <json_lines.hpp>
+#include <nlohmann/json.hpp>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+// Shows the bytes of a failing case
+std::string printable(std::string_view text)
+{
+  std::string result;
+  for (const auto c : text) {
+    const auto byte = static_cast<unsigned char>(c);
+    if (byte < 0x20 || byte >= 0x7F) {
+      result += fmt::format("\\x{:02x}", byte);
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+const std::string replacement = "\xEF\xBF\xBD";
+
+struct string_case
+{
+  std::string text;
+  // As written by append_json_string, quotes included
+  std::string escaped;
+  // As decoded by a JSON parser
+  std::string decoded;
+};
+
+void test_strings()
+{
+  const string_case cases[] = {
+      {"", "\"\"", ""},
+      {"plain text", "\"plain text\"", "plain text"},
+      // Quotes and backslashes
+      {"say \"hi\"", "\"say \\\"hi\\\"\"", "say \"hi\""},
+      {"C:\\path\\", "\"C:\\\\path\\\\\"", "C:\\path\\"},
+      // Control characters: the short escapes, then \u00XX
+      {"a\nb\tc\r", "\"a\\nb\\tc\\r\"", "a\nb\tc\r"},
+      {"\b\f", "\"\\b\\f\"", "\b\f"},
+      {std::string {"\0\x01\x1f", 3}, "\"\\u0000\\u0001\\u001f\"",
+       std::string {"\0\x01\x1f", 3}},
+      {"\x7f", "\"\x7f\"", "\x7f"},
+      // Valid UTF-8 is kept as is
+      {"caf\xC3\xA9", "\"caf\xC3\xA9\"", "caf\xC3\xA9"},
+      {"\xE2\x82\xAC", "\"\xE2\x82\xAC\"", "\xE2\x82\xAC"},
+      {"\xF0\x9F\x98\x80", "\"\xF0\x9F\x98\x80\"", "\xF0\x9F\x98\x80"},
+      // Invalid UTF-8 becomes U+FFFD, a byte at a time
+      {"\xFF", "\"\\ufffd\"", replacement},
+      {"a\x80z", "\"a\\ufffdz\"", "a" + replacement + "z"},
+      // Truncated, overlong, surrogate and past U+10FFFF
+      {"\xE2\x82", "\"\\ufffd\\ufffd\"", replacement + replacement},
+      {"\xC0\xAF", "\"\\ufffd\\ufffd\"", replacement + replacement},
+      {"\xED\xA0\x80",
+       "\"\\ufffd\\ufffd\\ufffd\"",
+       replacement + replacement + replacement},
+      {"\xF4\x90\x80\x80",
+       "\"\\ufffd\\ufffd\\ufffd\\ufffd\"",
+       replacement + replacement + replacement + replacement},
+  };
+  for (const auto& c : cases) {
+    fmt::memory_buffer out;
+    search::append_json_string(out, c.text);
+    const std::string escaped {out.data(), out.size()};
+    check(escaped == c.escaped, "escaping " + printable(c.text));
+
+    const auto value = nlohmann::json::parse(escaped, nullptr, false);
+    check(value.is_string() && value.get<std::string>() == c.decoded,
+          "parsing the escaped " + printable(c.text));
+  }
+}
+
+// Checks that `out` is a single JSON line with the given values
+void check_line(const fmt::memory_buffer& out,
+                std::string_view filename,
+                std::string_view snippet,
+                std::size_t query_id,
+                const std::string& what)
+{
+  const std::string_view line {out.data(), out.size()};
+  check(!line.empty() && line.back() == '\n'
+            && line.find('\n') == line.size() - 1,
+        what + ": not a single line");
+
+  const auto value = nlohmann::json::parse(line, nullptr, false);
+  if (value.is_discarded() || !value.is_object()) {
+    check(false, what + ": invalid JSON " + printable(line));
+    return;
+  }
+  check(value.value("start_line", 0u) == 3 && value.value("end_line", 0u) == 5,
+        what + ": lines");
+  check(value.contains("query_id") == (query_id != 0)
+            && value.value("query_id", std::size_t {0}) == query_id,
+        what + ": query_id");
+
+  // Valid UTF-8 comes back unchanged; anything else only has to parse
+  const auto is_plain = [](std::string_view text)
+  {
+    for (const auto c : text) {
+      if (static_cast<unsigned char>(c) >= 0x80) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (is_plain(filename)) {
+    check(value.value("filename", "") == filename, what + ": filename");
+  }
+  if (is_plain(snippet)) {
+    check(value.value("snippet", "") == snippet, what + ": snippet");
+  }
+}
+
+void test_lines()
+{
+  struct line_case
+  {
+    std::string filename;
+    std::string snippet;
+    std::size_t query_id;
+  };
+  const line_case cases[] = {
+      {"src/a.cpp", "int main() {\n  return 0;\n}", 0},
+      {"src/\"quoted\".cpp", "auto s = \"\\\\\";\r\n", 2},
+      {"dir\\with\\backslashes.h", "\t\x01\x1b[31m", 0},
+      {"latin1_caf\xE9.c", "// \xFF\xFE comment \xC3\xA9", 7},
+      {"\x80\x81", "\xED\xA0\x80\xF4\x90\x80\x80", 1},
+  };
+  for (const auto& c : cases) {
+    fmt::memory_buffer out;
+    search::append_json_line(out, c.filename, 3, 5, c.snippet, c.query_id);
+    check_line(out,
+               c.filename,
+               c.snippet,
+               c.query_id,
+               "line for " + printable(c.filename));
+  }
+}
+
+void test_random_bytes()
+{
+  std::mt19937 rng(11);
+  for (int i = 0; i < 20000; ++i) {
+    std::string filename(rng() % 16, ' ');
+    std::string snippet(rng() % 64, ' ');
+    // Mostly ASCII, with control characters, quotes, backslashes and
+    // bytes of the UTF-8 lead and continuation ranges mixed in
+    static const char specials[] = "\"\\\n\r\t\x01\x1f\x7f";
+    for (auto* text : {&filename, &snippet}) {
+      for (auto& c : *text) {
+        switch (rng() % 4) {
+          case 0:
+            c = static_cast<char>(0x80 + rng() % 0x80);
+            break;
+          case 1:
+            c = specials[rng() % (sizeof(specials) - 1)];
+            break;
+          default:
+            c = static_cast<char>(0x20 + rng() % 0x5F);
+            break;
+        }
+      }
+    }
+    const auto query_id = static_cast<std::size_t>(i % 3);
+    fmt::memory_buffer out;
+    search::append_json_line(out, filename, 3, 5, snippet, query_id);
+    check_line(
+        out, filename, snippet, query_id, "random line " + std::to_string(i));
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  test_strings();
+  test_lines();
+  test_random_bytes();
+
+  if (failures != 0) {
+    return 1;
+  }
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,210 @@
+// Tests of the --regex engine against std::regex (ECMAScript): random
+// texts for a table of patterns, with and without ignore_case, the
+// anchor edge cases, the DFA cache reset and the required literals the
+// prefilter relies on.
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <regex.hpp>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+char to_lower(char c)
+{
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool contains(const std::string& text, const std::string& literal, bool icase)
+{
+  return std::search(text.begin(),
+                     text.end(),
+                     literal.begin(),
+                     literal.end(),
+                     [icase](char a, char b)
+                     { return icase ? to_lower(a) == to_lower(b) : a == b; })
+      != text.end();
+}
+
+const char* const patterns[] = {
+    // Literals and alternation
+    "foo",
+    "foo|bar",
+    "(Read|Write)Buffer",
+    "a|",
+    "(a|b)*abb",
+    // Repetition, bounded and not
+    "a+b*",
+    "colou?r",
+    "x{2}y",
+    "x{2,}y",
+    "x{2,3}y",
+    "(ab){1,2}c",
+    // Classes
+    "[^a-c]z",
+    "[\\]a]+",
+    "[a\\-z]",
+    "\\d+\\.\\d*",
+    "\\w+_\\W",
+    "\\s\\S",
+    "[^A]b",
+    "GET[a-c]+",
+    // Anchors
+    "^getHandler$",
+    "^get.*Handler$",
+    "^ab|cd$",
+    "^$",
+    "$$",
+    "a$$",
+    "^^a",
+    "^$$",
+    "$^",
+    "(a|$)$",
+    "",
+};
+
+// Mostly bytes the patterns care about, so that matches are common
+std::string random_text(std::mt19937& rng)
+{
+  static const std::string alphabet =
+      "abcdxyzRWgetHandlerBuf_.01-] \nABCGHfoobar";
+  std::string text;
+  const auto size = rng() % 14;
+  for (std::size_t i = 0; i < size; ++i) {
+    text += alphabet[rng() % alphabet.size()];
+  }
+  return text;
+}
+
+void test_against_std_regex()
+{
+  std::mt19937 rng(3);
+  for (const bool icase : {false, true}) {
+    for (const auto* pattern : patterns) {
+      search::regex re;
+      std::string error;
+      if (!re.compile(pattern, error, icase)) {
+        check(false, std::string {"compile "} + pattern + ": " + error);
+        continue;
+      }
+      const std::regex expected(pattern,
+                                icase ? std::regex::ECMAScript
+                                        | std::regex::icase
+                                      : std::regex::ECMAScript);
+      for (int i = 0; i < 5000; ++i) {
+        const auto text = random_text(rng);
+        const bool matched = re.search(text);
+        check(matched == std::regex_search(text, expected),
+              std::string {pattern} + (icase ? " (icase)" : "") + " on '"
+                  + text + "'");
+
+        // The prefilter skips texts without any of the literals
+        const auto& literals = re.required_literals();
+        if (matched && !literals.empty()) {
+          check(std::any_of(literals.begin(),
+                            literals.end(),
+                            [&](const std::string& literal)
+                            { return contains(text, literal, icase); }),
+                std::string {pattern} + " matched '" + text
+                    + "' without a required literal");
+        }
+      }
+    }
+  }
+}
+
+void test_required_literals()
+{
+  struct literals_case
+  {
+    const char* pattern;
+    std::vector<std::string> expected;
+  };
+  const literals_case cases[] = {
+      {"foo", {"foo"}},
+      {"foo|bar", {"bar", "foo"}},
+      {"get.*Handler", {"Handler"}},
+      {"(Read|Write)Buffer", {"ReadBuffer", "WriteBuffer"}},
+      {"colou?r", {"color", "colour"}},
+      {"[ab]c", {"ac", "bc"}},
+      {"^main$", {"main"}},
+      // Nothing is required of every match
+      {".*", {}},
+      {"a*", {}},
+      {"ab|.*", {}},
+  };
+  for (const auto& c : cases) {
+    search::regex re;
+    std::string error;
+    check(re.compile(c.pattern, error), std::string {"compile "} + c.pattern);
+    auto literals = re.required_literals();
+    std::sort(literals.begin(), literals.end());
+    check(literals == c.expected,
+          std::string {"required literals of "} + c.pattern);
+  }
+}
+
+void test_dfa_reset()
+{
+  // The DFA of this pattern has a state per combination of the last 13
+  // bytes, 8192 in all, which random texts soon need more than the 4096
+  // it keeps before starting over
+  search::regex re;
+  std::string error;
+  check(re.compile("(a|b)*a(a|b){12}", error), "compile reset pattern");
+
+  std::mt19937 rng(5);
+  for (int i = 0; i < 5000; ++i) {
+    std::string text;
+    const auto size = 1 + rng() % 40;
+    for (std::size_t j = 0; j < size; ++j) {
+      text += (rng() % 2 == 0) ? 'a' : 'b';
+    }
+    // An `a` followed by at least 12 more bytes
+    const auto a = text.find('a');
+    const bool expected = a != std::string::npos && text.size() - a > 12;
+    check(re.search(text) == expected,
+          "reset pattern on a text of size " + std::to_string(size));
+  }
+}
+
+void test_invalid_patterns()
+{
+  for (const auto* pattern : {"(", "a)", "*a", "a{3,1}", "[a", "\\q", "a\\"})
+  {
+    search::regex re;
+    std::string error;
+    check(!re.compile(pattern, error) && !error.empty(),
+          std::string {"rejects "} + pattern);
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  test_against_std_regex();
+  test_required_literals();
+  test_dfa_reset();
+  test_invalid_patterns();
+
+  if (failures != 0) {
+    return 1;
+  }
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,204 @@
+// Differential fuzzer for the strstr kernels: every kernel must agree
+// with std::string_view::find (or a case-insensitive find for the
+// strcasestr kernels), must never match in the padding and must
+// never read past it (build with -fsanitize=address to check the latter).
+//
+// Built with -D ENABLE_LIBFUZZER=ON (Clang), this is a libFuzzer target.
+// Otherwise it has its own main(), which runs a number of random cases,
+// e.g., under CTest.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string_view>
+
+#include <sse2_strstr.hpp>
+
+namespace
+{
+using kernel_fn = std::size_t (*)(const std::string_view&,
+                                  const std::string_view&,
+                                  std::size_t);
+
+struct kernel
+{
+  const char* name;
+  kernel_fn fn;
+  bool supported;
+};
+
+const kernel kernels[] = {
+    {"simd", search::simd_strstr, true},
+    {"sse2", search::sse2_strstr_v2, true},
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx2", search::avx2_strstr_v2, __builtin_cpu_supports("avx2") != 0},
+    {"avx512bw",
+     search::avx512bw_strstr_v2,
+     __builtin_cpu_supports("avx512bw") != 0},
+#endif
+};
+
+const kernel ignore_case_kernels[] = {
+    {"simd", search::simd_strcasestr, true},
+    {"sse2", search::sse2_strcasestr, true},
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx2", search::avx2_strcasestr, __builtin_cpu_supports("avx2") != 0},
+    {"avx512bw",
+     search::avx512bw_strcasestr,
+     __builtin_cpu_supports("avx512bw") != 0},
+#endif
+};
+
+char to_lower(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+std::size_t find_ignore_case(std::string_view haystack,
+                             std::string_view needle)
+{
+  const auto found = std::search(haystack.begin(),
+                                 haystack.end(),
+                                 needle.begin(),
+                                 needle.end(),
+                                 [](char a, char b)
+                                 { return to_lower(a) == to_lower(b); });
+  return found == haystack.end() && !needle.empty()
+      ? std::string_view::npos
+      : static_cast<std::size_t>(found - haystack.begin());
+}
+
+void check_kernels(const kernel* first,
+                   const kernel* last,
+                   const char* suffix,
+                   std::string_view haystack,
+                   std::string_view needle,
+                   std::size_t padding,
+                   std::size_t expected)
+{
+  for (const auto* k = first; k != last; ++k) {
+    if (!k->supported) {
+      continue;
+    }
+    const auto found = k->fn(haystack, needle, padding);
+    if (found != expected) {
+      std::fprintf(stderr,
+                   "%s_%s: found %zd, expected %zd "
+                   "(haystack size %zu, needle size %zu, padding %zu)\n",
+                   k->name,
+                   suffix,
+                   static_cast<std::ptrdiff_t>(found),
+                   static_cast<std::ptrdiff_t>(expected),
+                   haystack.size(),
+                   needle.size(),
+                   padding);
+      std::abort();
+    }
+  }
+}
+
+// Searches `haystack` with `padding` readable bytes after it. The padding
+// repeats the needle, so a kernel that matches past the end is caught.
+void check(std::string_view haystack,
+           std::string_view needle,
+           std::size_t padding)
+{
+  const auto size = haystack.size() + padding;
+  // Exactly this many bytes, so that AddressSanitizer catches any read
+  // past the padding
+  std::unique_ptr<char[]> buffer(new char[size == 0 ? 1 : size]);
+  std::memcpy(buffer.get(), haystack.data(), haystack.size());
+  for (std::size_t i = 0; i < padding && !needle.empty(); ++i) {
+    buffer[haystack.size() + i] = needle[i % needle.size()];
+  }
+  const std::string_view copy {buffer.get(), haystack.size()};
+
+  check_kernels(std::begin(kernels),
+                std::end(kernels),
+                "strstr",
+                copy,
+                needle,
+                padding,
+                copy.find(needle));
+  check_kernels(std::begin(ignore_case_kernels),
+                std::end(ignore_case_kernels),
+                "strcasestr",
+                copy,
+                needle,
+                padding,
+                find_ignore_case(copy, needle));
+}
+
+// Input layout: needle size, padding, then the needle and the haystack.
+// A needle size past the end of the input takes the needle from the
+// haystack instead, so that there are hits to find.
+void check_input(const std::uint8_t* data, std::size_t size)
+{
+  if (size < 2) {
+    return;
+  }
+  const std::size_t needle_size = data[0] % 80;
+  const std::size_t padding = data[1] % 72;
+  const std::string_view rest {reinterpret_cast<const char*>(data) + 2,
+                               size - 2};
+
+  if (needle_size <= rest.size() && data[0] < 128) {
+    check(rest.substr(needle_size), rest.substr(0, needle_size), padding);
+  } else if (!rest.empty()) {
+    const auto at = data[0] % rest.size();
+    check(rest, rest.substr(at, needle_size), padding);
+  }
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size)
+{
+  check_input(data, size);
+  return 0;
+}
+
+#if !defined(FCCF_LIBFUZZER)
+// Usage: fccf_strstr_fuzz [iterations] [seed]
+int main(int argc, char* argv[])
+{
+  const auto iterations =
+      argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000ull;
+  std::uint64_t state = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+  if (state == 0) {
+    state = 1;
+  }
+  const auto next = [&state]
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  };
+
+  std::uint8_t input[600];
+  for (std::uint64_t i = 0; i < iterations; ++i) {
+    const auto size = 2 + next() % (sizeof(input) - 2);
+    // Few distinct bytes give many partial matches
+    const auto alphabet = 1 + next() % 4;
+    // Half the cases mix in uppercase, for the case-insensitive kernels
+    const auto uppercase = next() % 2;
+    input[0] = static_cast<std::uint8_t>(next());
+    input[1] = static_cast<std::uint8_t>(next());
+    for (std::size_t j = 2; j < size; ++j) {
+      const char base = (uppercase != 0 && next() % 2 == 0) ? 'A' : 'a';
+      input[j] = static_cast<std::uint8_t>(base + next() % alphabet);
+    }
+    check_input(input, size);
+  }
+  std::printf("%llu cases passed\n",
+              static_cast<unsigned long long>(iterations));
+  return 0;
+}
+#endif